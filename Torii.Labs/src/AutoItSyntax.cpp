@@ -7,6 +7,7 @@
 #include <array>
 #include <cctype>
 #include <string>
+#include <string_view>
 
 namespace
 {
@@ -95,7 +96,7 @@ namespace
         if (inBegin >= inEnd)
             return false;
 
-        AutoItPreprocessor::Tokenizer::Tokenizer tokenizer(std::string(inBegin, inEnd));
+        AutoItPreprocessor::Tokenizer::Tokenizer tokenizer(std::string_view(inBegin, static_cast<std::size_t>(inEnd - inBegin)));
         const auto token = tokenizer.Next();
         if (token.Is(AutoItPreprocessor::Tokenizer::TokenKind::End))
             return false;
@@ -8,6 +8,7 @@
 #include "settings/WorkspaceSettingsFile.h"
 
 #include "AutoItPreprocessor/Common/SourceDocument.h"
+#include "AutoItPreprocessor/Compiler/CompilationSession.h"
 #include "AutoItPreprocessor/Compiler/Compiler.h"
 
 #if defined(_WIN32)
@@ -265,6 +266,11 @@ namespace AutoItPlus::Editor
 {
     namespace
     {
+        // Builds show the generated code and map it back to the sources; tokens and stripped code go unused.
+        constexpr auto kBuildOutputs = AutoItPreprocessor::Compiler::CompilerOutputs::GeneratedCode
+            | AutoItPreprocessor::Compiler::CompilerOutputs::LineMappings
+            | AutoItPreprocessor::Compiler::CompilerOutputs::IncludeExpansions;
+
         bool HasDirtyDocuments(const EditorState& state)
         {
             return std::any_of(state.documents.begin(), state.documents.end(), [](const DocumentState& document) {
@@ -281,10 +287,14 @@ namespace AutoItPlus::Editor
                 return mappings;
 
             const auto normalizedDocumentPath = std::filesystem::absolute(documentPath).lexically_normal();
+            std::vector<bool> isDocumentFile;
+            isDocumentFile.reserve(compilation.includedFiles.size());
+            for (const auto& includedFile : compilation.includedFiles)
+                isDocumentFile.push_back(std::filesystem::absolute(includedFile).lexically_normal() == normalizedDocumentPath);
+
             for (const auto& mapping : compilation.lineMappings)
             {
-                const auto normalizedSourcePath = std::filesystem::absolute(mapping.sourcePath).lexically_normal();
-                if (normalizedSourcePath != normalizedDocumentPath || mapping.sourceLine == 0)
+                if (mapping.sourceFile >= isDocumentFile.size() || !isDocumentFile[mapping.sourceFile] || mapping.sourceLine == 0)
                     continue;
 
                 if (mappings.size() <= mapping.sourceLine)
@@ -682,12 +692,15 @@ namespace AutoItPlus::Editor
         return options;
     }
 
-    AutoItPreprocessor::Compiler::CompilationUnit RunCompilation(const EditorState& state, const DocumentState& document)
+    AutoItPreprocessor::Compiler::CompilationUnit RunCompilation(
+        const EditorState& state,
+        const DocumentState& document,
+        AutoItPreprocessor::Compiler::CompilerOutputs outputs)
     {
-        AutoItPreprocessor::Compiler::Compiler compiler;
-        const auto options = BuildCompilerOptions(state, document);
+        auto options = BuildCompilerOptions(state, document);
+        options.outputs = outputs;
 
-        return compiler.Compile(
+        return state.compiler->Compile(
             AutoItPreprocessor::Common::SourceDocument{
                 .path = document.path,
                 .text = document.editor->GetText()
@@ -710,7 +723,16 @@ namespace AutoItPlus::Editor
 
         try
         {
-            const auto compilation = RunCompilation(state, document);
+            // The preview recompiles on every pause in typing, so it keeps a session and only patches the edited lines.
+            auto options = BuildCompilerOptions(state, document);
+            if (document.previewSession == nullptr || document.previewSession->GetOptions() != options)
+                document.previewSession = std::make_unique<AutoItPreprocessor::Compiler::CompilationSession>(std::move(options));
+
+            const auto& compilation = document.previewSession->Update(
+                AutoItPreprocessor::Common::SourceDocument{
+                    .path = document.path,
+                    .text = document.editor->GetText()
+                });
             document.previewText = SanitizeUtf8Lossy(compilation.generatedCode);
             document.previewLineMappings = BuildPreviewLineMappings(compilation, document.path);
             if (document.previewEditor != nullptr)
@@ -840,7 +862,7 @@ namespace AutoItPlus::Editor
 
     void PreviewTokens(EditorState& state, DocumentState& document)
     {
-        const auto compilation = RunCompilation(state, document);
+        const auto compilation = RunCompilation(state, document, AutoItPreprocessor::Compiler::CompilerOutputs::Tokens);
         document.tokenView = BuildTokenView(compilation.tokens);
         document.outputText.clear();
         document.outputKind = OutputKind::Tokens;
@@ -849,8 +871,8 @@ namespace AutoItPlus::Editor
 
     void PreviewStripped(EditorState& state, DocumentState& document)
     {
-        const auto compilation = RunCompilation(state, document);
-        document.outputText = compilation.strippedCode;
+        auto compilation = RunCompilation(state, document, AutoItPreprocessor::Compiler::CompilerOutputs::StrippedCode);
+        document.outputText = std::move(compilation.strippedCode);
         document.tokenView.clear();
         document.outputKind = OutputKind::Stripped;
         document.status = "Prepared stripped preview.";
@@ -858,8 +880,8 @@ namespace AutoItPlus::Editor
 
     void PreviewCompiled(EditorState& state, DocumentState& document)
     {
-        const auto compilation = RunCompilation(state, document);
-        document.outputText = compilation.generatedCode;
+        auto compilation = RunCompilation(state, document, AutoItPreprocessor::Compiler::CompilerOutputs::GeneratedCode);
+        document.outputText = std::move(compilation.generatedCode);
         document.tokenView.clear();
         document.outputKind = OutputKind::Compiled;
         document.status = "Prepared compiled preview.";
@@ -1182,7 +1204,8 @@ namespace AutoItPlus::Editor
         SaveProject(*state.project);
 
         const DocumentState fallbackDocument{};
-        const auto options = BuildCompilerOptions(state, HasOpenDocument(state) ? CurrentDocument(state) : fallbackDocument);
+        auto options = BuildCompilerOptions(state, HasOpenDocument(state) ? CurrentDocument(state) : fallbackDocument);
+        options.outputs = kBuildOutputs;
         const auto mainFilePath = state.project->mainFilePath;
         const auto outputPath = GetProjectBuildOutputPath(*state.project, state.buildConfiguration);
         const auto buildLabel = std::string(BuildConfigurationLabel(state.buildConfiguration));
@@ -1190,15 +1213,14 @@ namespace AutoItPlus::Editor
         state.buildPreviewStatus = "Building project...";
         if (HasOpenDocument(state))
             CurrentDocument(state).status = state.buildPreviewStatus;
-        state.buildTask = std::async(std::launch::async, [mainFilePath, options, outputPath, buildLabel]() -> BuildTaskResult {
+        state.buildTask = std::async(std::launch::async, [compiler = state.compiler, mainFilePath, options, outputPath, buildLabel]() -> BuildTaskResult {
             BuildTaskResult result;
             result.projectBuild = true;
             result.documentPath = mainFilePath;
             result.outputPath = outputPath;
             try
             {
-                AutoItPreprocessor::Compiler::Compiler compiler;
-                result.compilation = compiler.Compile(mainFilePath, options);
+                result.compilation = compiler->Compile(mainFilePath, options);
                 result.previewText = SanitizeUtf8Lossy(result.compilation.generatedCode);
                 WriteTextFile(outputPath, result.previewText);
                 result.status = "Built " + outputPath.string() + " [" + buildLabel + "]";
@@ -1228,18 +1250,18 @@ namespace AutoItPlus::Editor
             .path = document.path,
             .text = document.editor->GetText()
         };
-        const auto options = BuildCompilerOptions(state, document);
+        auto options = BuildCompilerOptions(state, document);
+        options.outputs = kBuildOutputs;
         const auto documentTitle = document.title;
         state.buildInProgress = true;
         document.status = "Building preview...";
         state.buildPreviewStatus = "Building preview...";
-        state.buildTask = std::async(std::launch::async, [sourceDocument, options, documentTitle]() -> BuildTaskResult {
+        state.buildTask = std::async(std::launch::async, [compiler = state.compiler, sourceDocument, options, documentTitle]() -> BuildTaskResult {
             BuildTaskResult result;
             result.documentPath = sourceDocument.path;
             try
             {
-                AutoItPreprocessor::Compiler::Compiler compiler;
-                result.compilation = compiler.Compile(sourceDocument, options);
+                result.compilation = compiler->Compile(sourceDocument, options);
                 result.previewText = SanitizeUtf8Lossy(result.compilation.generatedCode);
                 result.status = "Built preview for " + documentTitle;
                 result.succeeded = true;
@@ -36,7 +36,10 @@ namespace AutoItPlus::Editor
     void RefreshOutline(EditorState& state, DocumentState& document);
 
     AutoItPreprocessor::Compiler::CompilerOptions BuildCompilerOptions(const EditorState& state, const DocumentState& document);
-    AutoItPreprocessor::Compiler::CompilationUnit RunCompilation(const EditorState& state, const DocumentState& document);
+    AutoItPreprocessor::Compiler::CompilationUnit RunCompilation(
+        const EditorState& state,
+        const DocumentState& document,
+        AutoItPreprocessor::Compiler::CompilerOutputs outputs);
     void RefreshLivePreview(EditorState& state, DocumentState& document);
     void ApplyBuildPreview(EditorState& state, DocumentState& document);
     void SyncPreviewHighlight(DocumentState& document, const EditorPreferences& preferences);
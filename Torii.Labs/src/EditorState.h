@@ -4,6 +4,7 @@
 #include "HotkeyManager.h"
 #include "SymbolAnalysis.h"
 #include "TextEditor.h"
+#include "AutoItPreprocessor/Compiler/CompilationSession.h"
 #include "AutoItPreprocessor/Compiler/Compiler.h"
 #include "imgui.h"
 
@@ -182,6 +183,7 @@ namespace AutoItPlus::Editor
         SyntaxFlavor sourceSyntax = SyntaxFlavor::AutoItPlus;
         std::unique_ptr<TextEditor> editor;
         std::unique_ptr<TextEditor> previewEditor;
+        std::unique_ptr<AutoItPreprocessor::Compiler::CompilationSession> previewSession;
         bool dirty = false;
         bool showWhitespace = false;
         bool previewDirty = true;
@@ -314,6 +316,8 @@ namespace AutoItPlus::Editor
         BuildConfiguration buildConfiguration = BuildConfiguration::Debug;
         BottomPanelTab activeBottomTab = BottomPanelTab::Output;
         std::optional<BottomPanelTab> requestedBottomTab;
+        // Shared with build tasks; keeps the project's rules parsed between builds and previews.
+        std::shared_ptr<const AutoItPreprocessor::Compiler::Compiler> compiler = std::make_shared<const AutoItPreprocessor::Compiler::Compiler>();
         std::future<BuildTaskResult> buildTask;
         bool buildInProgress = false;
         bool runAfterBuild = false;
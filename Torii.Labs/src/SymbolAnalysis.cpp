@@ -2,18 +2,18 @@
 
 #include "EditorServices.h"
 
+#include "AutoItPreprocessor/Compiler/IncludeDirective.h"
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 #include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
 
 #include <algorithm>
-#include <cctype>
-#include <sstream>
 #include <map>
 #include <set>
 #include <unordered_map>
 
 namespace
 {
+    using AutoItPreprocessor::Tokenizer::Keyword;
     using AutoItPreprocessor::Tokenizer::Token;
     using AutoItPreprocessor::Tokenizer::TokenKind;
 
@@ -29,15 +29,6 @@ namespace
         std::set<std::string> usedVariables;
     };
 
-    std::string TrimCopy(const std::string& text)
-    {
-        const auto begin = std::find_if_not(text.begin(), text.end(), [](unsigned char ch) { return std::isspace(ch) != 0; });
-        const auto end = std::find_if_not(text.rbegin(), text.rend(), [](unsigned char ch) { return std::isspace(ch) != 0; }).base();
-        if (begin >= end)
-            return {};
-        return std::string(begin, end);
-    }
-
     bool IsTrivia(TokenKind kind)
     {
         return kind == TokenKind::Space
@@ -49,11 +40,27 @@ namespace
 
     bool IsDeclarationKeyword(const Token& token)
     {
-        if (!token.Is(TokenKind::Keyword))
-            return false;
+        switch (token.GetKeyword())
+        {
+            case Keyword::Local:
+            case Keyword::Global:
+            case Keyword::Dim:
+            case Keyword::Const:
+            case Keyword::Static:
+                return true;
+            default:
+                return false;
+        }
+    }
 
-        const auto value = AutoItPreprocessor::Tokenizer::ToLowerCopy(token.GetContent());
-        return value == "local" || value == "global" || value == "dim" || value == "const" || value == "static";
+    bool IsFollowedByOpenParen(AutoItPreprocessor::Tokenizer::Tokenizer& tokenizer)
+    {
+        for (std::size_t offset = 0;; ++offset)
+        {
+            const auto next = tokenizer.Peek(offset);
+            if (!IsTrivia(next.GetKind()))
+                return next.Is(TokenKind::OpenedParen);
+        }
     }
 
     bool IsInsideFunction(std::size_t functionDepth)
@@ -61,27 +68,20 @@ namespace
         return functionDepth > 0;
     }
 
-    std::vector<AutoItPlus::Editor::IncludeSymbol> ParseIncludes(const std::string& text)
+    std::vector<AutoItPlus::Editor::IncludeSymbol> ParseIncludes(std::string_view text)
     {
         std::vector<AutoItPlus::Editor::IncludeSymbol> includes;
-        std::istringstream stream(text);
-        std::string line;
         int lineNumber = 1;
-        while (std::getline(stream, line))
+        std::size_t position = 0;
+        while (position < text.size())
         {
-            const std::string trimmed = TrimCopy(line);
-            const std::string lowered = AutoItPreprocessor::Tokenizer::ToLowerCopy(trimmed);
-            if (!lowered.starts_with("#include"))
-            {
-                ++lineNumber;
-                continue;
-            }
+            const auto lineEnd = text.find('\n', position);
+            const auto line = text.substr(position, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - position);
+            position = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1U;
 
-            const std::string payload = TrimCopy(trimmed.substr(8));
-            if (payload.size() >= 2U && payload.front() == '"' && payload.back() == '"')
-                includes.push_back({payload.substr(1, payload.size() - 2U), lineNumber, false});
-            else if (payload.size() >= 2U && payload.front() == '<' && payload.back() == '>')
-                includes.push_back({payload.substr(1, payload.size() - 2U), lineNumber, true});
+            const auto directive = AutoItPreprocessor::Compiler::ScanIncludeDirective(line);
+            if (directive.IsInclude() && directive.IsWellFormed())
+                includes.push_back({std::string(directive.name), lineNumber, directive.global});
 
             ++lineNumber;
         }
@@ -94,7 +94,6 @@ namespace
         ParsedFileSymbols result;
         result.includes = ParseIncludes(text);
         AutoItPreprocessor::Tokenizer::Tokenizer tokenizer(text);
-        const auto tokens = tokenizer.TokenizeAll();
 
         std::size_t functionDepth = 0;
         AutoItPlus::Editor::FunctionSymbol* currentFunction = nullptr;
@@ -106,21 +105,23 @@ namespace
         bool declarationIsConst = false;
         bool declarationIsStatic = false;
 
-        for (std::size_t index = 0; index < tokens.size(); ++index)
+        while (true)
         {
-            const auto& token = tokens[index];
-            if (token.Is(TokenKind::End) || token.Is(TokenKind::Error) || IsTrivia(token.GetKind()))
+            const auto token = tokenizer.Next();
+            if (token.Is(TokenKind::End) || token.Is(TokenKind::Error))
+                break;
+            if (IsTrivia(token.GetKind()))
                 continue;
 
-            const auto lowered = AutoItPreprocessor::Tokenizer::ToLowerCopy(token.GetContent());
-            if (token.Is(TokenKind::Keyword) && lowered == "func")
+            const auto keyword = token.GetKeyword();
+            if (keyword == Keyword::Func)
             {
                 expectFunctionName = true;
                 ++functionDepth;
                 continue;
             }
 
-            if (token.Is(TokenKind::Keyword) && lowered == "endfunc")
+            if (keyword == Keyword::EndFunc)
             {
                 if (functionDepth > 0)
                     --functionDepth;
@@ -131,7 +132,7 @@ namespace
 
             if (expectFunctionName && token.Is(TokenKind::Word))
             {
-                result.functions.push_back({token.GetContent(), static_cast<int>(token.GetLine()), {}, {}});
+                result.functions.push_back({std::string(token.GetContent()), static_cast<int>(token.GetLine()), {}, {}});
                 currentFunction = &result.functions.back();
                 result.localFunctions.insert(AutoItPreprocessor::Tokenizer::ToLowerCopy(token.GetContent()));
                 expectFunctionName = false;
@@ -170,7 +171,7 @@ namespace
                 }
 
                 if (parameterParenDepth == 1 && token.Is(TokenKind::Variable) && currentFunction != nullptr)
-                    currentFunction->parameters.push_back({token.GetContent(), static_cast<int>(token.GetLine())});
+                    currentFunction->parameters.push_back({std::string(token.GetContent()), static_cast<int>(token.GetLine())});
 
                 continue;
             }
@@ -178,8 +179,8 @@ namespace
             if (IsDeclarationKeyword(token))
             {
                 expectDeclVariable = true;
-                declarationIsConst = lowered == "const";
-                declarationIsStatic = lowered == "static";
+                declarationIsConst = keyword == Keyword::Const;
+                declarationIsStatic = keyword == Keyword::Static;
                 continue;
             }
 
@@ -187,7 +188,7 @@ namespace
             {
                 if (token.Is(TokenKind::Variable))
                 {
-                    AutoItPlus::Editor::VariableSymbol symbol{token.GetContent(), static_cast<int>(token.GetLine())};
+                    AutoItPlus::Editor::VariableSymbol symbol{std::string(token.GetContent()), static_cast<int>(token.GetLine())};
                     if (IsInsideFunction(functionDepth) && currentFunction != nullptr)
                         currentFunction->locals.push_back(symbol);
                     else if (declarationIsConst)
@@ -209,11 +210,7 @@ namespace
 
             if (token.Is(TokenKind::Word))
             {
-                std::size_t nextIndex = index + 1U;
-                while (nextIndex < tokens.size() && IsTrivia(tokens[nextIndex].GetKind()))
-                    ++nextIndex;
-
-                if (nextIndex < tokens.size() && tokens[nextIndex].Is(TokenKind::OpenedParen))
+                if (IsFollowedByOpenParen(tokenizer))
                     result.usedFunctions.insert(AutoItPreprocessor::Tokenizer::ToLowerCopy(token.GetContent()));
             }
             else if (token.Is(TokenKind::Variable))
@@ -0,0 +1,477 @@
+#include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
+#include "AutoItPreprocessor/Compiler/Emitter.h"
+#include "AutoItPreprocessor/Compiler/IncludeResolver.h"
+#include "AutoItPreprocessor/Compiler/OutputSink.h"
+#include "AutoItPreprocessor/Tokenizer/Keyword.h"
+#include "AutoItPreprocessor/Tokenizer/Token.h"
+#include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    using namespace AutoItPreprocessor;
+
+    constexpr std::size_t kMicroLines = 20000;
+    constexpr std::array<std::size_t, 3> kProjectLines = {10000, 100000, 1000000};
+    constexpr std::size_t kWideFiles = 64;
+    constexpr std::size_t kDeepLevels = 64;
+    constexpr std::size_t kLinesPerBlock = 11;
+
+    constexpr std::string_view kRules =
+        "token BenchScale\n"
+        "match=__BENCH_SCALE__\n"
+        "emit=2\n"
+        "kinds=Word\n"
+        "end\n"
+        "\n"
+        "token BenchCall\n"
+        "pattern=BENCH_CALL_*\n"
+        "emit=Bench_Call\\1\n"
+        "kinds=Word\n"
+        "end\n"
+        "\n"
+        "sequence BenchMsgBox\n"
+        "match=Word:MsgBox OpenedParen * Comma * ClosedParen\n"
+        "emit=ConsoleWrite(\\5 & @CRLF)\n"
+        "case=insensitive\n"
+        "end\n";
+
+    struct CommandLine
+    {
+        std::filesystem::path outputFile;
+        std::filesystem::path workDir;
+        std::string filter;
+        bool quick = false;
+    };
+
+    // The size of what one iteration of a benchmark processes.
+    struct Workload
+    {
+        std::size_t bytes = 0;
+        std::size_t tokens = 0;
+        std::size_t lines = 0;
+    };
+
+    struct Measurement
+    {
+        std::string name;
+        std::string group;
+        Workload workload;
+        std::size_t iterations = 0;
+        double seconds = 0.0;
+    };
+
+    struct Project
+    {
+        std::filesystem::path rootFile;
+        Workload workload;
+    };
+
+    void PrintUsage()
+    {
+        std::cerr
+            << "Usage:\n"
+            << "  AutoItPreprocessor.Bench [--out <results.json>] [--work-dir <dir>] [--filter <text>] [--quick]\n"
+            << "      Writes JSON results to standard output unless --out is given. --filter runs only the benchmarks\n"
+            << "      whose name contains the text; --quick shortens every run and compiles only the smallest projects.\n";
+    }
+
+    CommandLine ParseArguments(int argc, char** argv)
+    {
+        CommandLine commandLine;
+        commandLine.workDir = std::filesystem::temp_directory_path() / "AutoItPreprocessor.Bench";
+
+        for (int index = 1; index < argc; ++index)
+        {
+            const std::string arg = argv[index];
+            if (arg == "--out")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing path after --out");
+                commandLine.outputFile = argv[index];
+            }
+            else if (arg == "--work-dir")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing path after --work-dir");
+                commandLine.workDir = argv[index];
+            }
+            else if (arg == "--filter")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing text after --filter");
+                commandLine.filter = argv[index];
+            }
+            else if (arg == "--quick")
+            {
+                commandLine.quick = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument: " + arg);
+            }
+        }
+
+        return commandLine;
+    }
+
+    // One function of a synthetic module: declarations, a loop, comments, strings, macros and custom tokens.
+    void AppendBlock(std::string& text, std::size_t module, std::size_t block)
+    {
+        const auto id = std::to_string(module) + "_" + std::to_string(block);
+        text += "; Module " + std::to_string(module) + " block " + std::to_string(block) + "\n";
+        text += "Func Bench_" + id + "($value, $count = 4)\n";
+        text += "    Local $total = 0, $text = \"Item \" & $value\n";
+        text += "    For $i = 1 To $count Step 1\n";
+        text += "        If Mod($i, 2) = 0 Then $total += $i * 0x1F ; even steps\n";
+        text += "        $total -= __BENCH_SCALE__\n";
+        text += "    Next\n";
+        text += "    If $total < 0 Then MsgBox(0, \"Bench\", $text)\n";
+        text += "    ConsoleWrite($text & \": \" & $total & @CRLF)\n";
+        text += "    Return BENCH_CALL_" + std::to_string(block % 10U) + "($total)\n";
+        text += "EndFunc\n";
+    }
+
+    std::string MakeModule(std::size_t module, std::size_t lineCount)
+    {
+        std::string text;
+        text.reserve(lineCount * 48U);
+        for (std::size_t block = 0; block * kLinesPerBlock < lineCount; ++block)
+            AppendBlock(text, module, block);
+
+        return text;
+    }
+
+    std::size_t CountTokens(std::string_view text)
+    {
+        std::size_t count = 0;
+        Tokenizer::Tokenizer tokenizer(text);
+        tokenizer.ForEachToken([&count](const Tokenizer::Token& token) {
+            if (!token.Is(Tokenizer::TokenKind::End))
+                ++count;
+        });
+
+        return count;
+    }
+
+    std::size_t CountLines(std::string_view text)
+    {
+        return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+
+    Workload Measure(std::string_view text)
+    {
+        return {.bytes = text.size(), .tokens = CountTokens(text), .lines = CountLines(text)};
+    }
+
+    void WriteFile(const std::filesystem::path& path, std::string_view text, Workload& total)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open())
+            throw std::runtime_error("Could not write " + path.string());
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+
+        const auto workload = Measure(text);
+        total.bytes += workload.bytes;
+        total.tokens += workload.tokens;
+        total.lines += workload.lines;
+    }
+
+    // A root including kWideFiles modules side by side, each of which also includes one shared module.
+    Project GenerateWideProject(const std::filesystem::path& directory, std::size_t lineCount)
+    {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+
+        Project project;
+        project.rootFile = directory / "root.au3";
+        const auto moduleLines = std::max<std::size_t>(lineCount / (kWideFiles + 2U), kLinesPerBlock);
+
+        WriteFile(directory / "shared.au3", "#include-once\n" + MakeModule(kWideFiles + 1U, moduleLines), project.workload);
+        std::string root;
+        for (std::size_t module = 0; module < kWideFiles; ++module)
+        {
+            const auto name = "module_" + std::to_string(module) + ".au3";
+            WriteFile(directory / name, "#include \"shared.au3\"\n" + MakeModule(module, moduleLines), project.workload);
+            root += "#include \"" + name + "\"\n";
+        }
+
+        WriteFile(project.rootFile, root + MakeModule(kWideFiles, moduleLines), project.workload);
+        return project;
+    }
+
+    // A chain of kDeepLevels modules where each one includes the next.
+    Project GenerateDeepProject(const std::filesystem::path& directory, std::size_t lineCount)
+    {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+
+        Project project;
+        project.rootFile = directory / "level_0.au3";
+        const auto moduleLines = std::max<std::size_t>(lineCount / kDeepLevels, kLinesPerBlock);
+
+        for (std::size_t level = 0; level < kDeepLevels; ++level)
+        {
+            std::string text;
+            if (level + 1U < kDeepLevels)
+                text = "#include \"level_" + std::to_string(level + 1U) + ".au3\"\n";
+            text += MakeModule(level, moduleLines);
+            WriteFile(directory / ("level_" + std::to_string(level) + ".au3"), text, project.workload);
+        }
+
+        return project;
+    }
+
+    class Runner
+    {
+    public:
+        explicit Runner(const CommandLine& commandLine)
+            : m_Filter(commandLine.filter)
+            , m_MinSeconds(commandLine.quick ? 0.05 : 0.5)
+        {
+        }
+
+        [[nodiscard]] bool Selects(std::string_view name) const noexcept
+        {
+            return m_Filter.empty() || name.find(m_Filter) != std::string_view::npos;
+        }
+
+        // Runs the body once to warm caches, then repeatedly until the minimum time has passed. The body returns a
+        // checksum so the work it does cannot be optimized away.
+        template <typename Body>
+        void Run(std::string name, std::string group, const Workload& workload, Body&& body)
+        {
+            if (!Selects(name))
+                return;
+
+            std::cerr << "Running " << name << "...\n";
+            std::size_t checksum = body();
+
+            Measurement measurement{.name = std::move(name), .group = std::move(group), .workload = workload};
+            const auto start = std::chrono::steady_clock::now();
+            do
+            {
+                checksum += body();
+                ++measurement.iterations;
+                measurement.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (measurement.seconds < m_MinSeconds);
+
+            volatile std::size_t sink = checksum;
+            static_cast<void>(sink);
+            m_Measurements.push_back(std::move(measurement));
+        }
+
+        [[nodiscard]] const std::vector<Measurement>& GetMeasurements() const noexcept { return m_Measurements; }
+
+    private:
+        std::string m_Filter;
+        double m_MinSeconds = 0.5;
+        std::vector<Measurement> m_Measurements;
+    };
+
+    void RunMicroBenchmarks(Runner& runner, const std::filesystem::path& rulesFile)
+    {
+        const auto source = MakeModule(0, kMicroLines);
+        const auto workload = Measure(source);
+
+        runner.Run("tokenizer.next", "micro", workload, [&source]() {
+            Tokenizer::Tokenizer tokenizer(source);
+            std::size_t count = 0;
+            while (!tokenizer.Next().Is(Tokenizer::TokenKind::End))
+                ++count;
+            return count;
+        });
+
+        runner.Run("tokenizer.tokenize_all", "micro", workload, [&source]() {
+            Tokenizer::Tokenizer tokenizer(source);
+            return tokenizer.TokenizeAll().size();
+        });
+
+        auto tokens = Tokenizer::Tokenizer(source).TokenizeAll();
+
+        std::vector<std::string_view> words;
+        Workload wordWorkload{.lines = workload.lines};
+        for (const auto& token : tokens)
+        {
+            if (token.Is(Tokenizer::TokenKind::Word) || token.Is(Tokenizer::TokenKind::Keyword))
+            {
+                words.push_back(token.GetContent());
+                wordWorkload.bytes += token.GetContent().size();
+            }
+        }
+        wordWorkload.tokens = words.size();
+
+        runner.Run("keyword.classify", "micro", wordWorkload, [&words]() {
+            std::size_t keywords = 0;
+            for (const auto word : words)
+                keywords += Tokenizer::ClassifyKeyword(word) != Tokenizer::Keyword::None ? 1U : 0U;
+            return keywords;
+        });
+
+        const auto registry = Compiler::CustomTokenRegistry::LoadFromFiles({rulesFile});
+        Compiler::CustomBindingStore expansions;
+        runner.Run("custom_tokens.match", "micro", workload, [&tokens, &registry, &expansions]() {
+            std::size_t matches = 0;
+            for (const auto& token : tokens)
+                matches += registry->Match(token, expansions) != nullptr ? 1U : 0U;
+            return matches;
+        });
+
+        // Emitted as a compile would see them, with the custom tokens already rebound.
+        for (auto& token : tokens)
+        {
+            if (const auto* binding = registry->Match(token, expansions))
+                token.RebindAsCustom(*binding);
+        }
+
+        runner.Run("emitter.emit", "micro", workload, [&tokens]() {
+            const auto result = Compiler::Emitter().Emit(tokens);
+            return result.code.size() + result.lineMappings.size();
+        });
+    }
+
+    void RunIncludeBenchmark(Runner& runner, const std::filesystem::path& workDir)
+    {
+        constexpr std::string_view kName = "include_resolver.resolve.wide";
+        if (!runner.Selects(kName))
+            return;
+
+        // Resolution reads through the process-wide include cache, so after the warm-up this times the steady state
+        // of a long-lived compiler.
+        const auto project = GenerateWideProject(workDir / "resolve-wide", kProjectLines.front());
+        const auto searchPath = Compiler::IncludeResolver::PrepareSearchPath({});
+        runner.Run(std::string(kName), "micro", project.workload, [&project, &searchPath]() {
+            const auto result = Compiler::IncludeResolver().Resolve(project.rootFile, searchPath);
+            return result.includedFiles.size();
+        });
+        std::filesystem::remove_all(project.rootFile.parent_path());
+    }
+
+    void RunMacroBenchmarks(Runner& runner, const CommandLine& commandLine, const std::filesystem::path& rulesFile)
+    {
+        Compiler::CompilerOptions options;
+        options.customRuleFiles = {rulesFile};
+        options.outputs = Compiler::CompilerOutputs::None;
+
+        const auto sizeCount = commandLine.quick ? std::size_t{1} : kProjectLines.size();
+        for (std::size_t sizeIndex = 0; sizeIndex < sizeCount; ++sizeIndex)
+        {
+            const auto lineCount = kProjectLines[sizeIndex];
+            for (const std::string_view shape : {"wide", "deep"})
+            {
+                const auto name = "compile." + std::string(shape) + "." + std::to_string(lineCount);
+                if (!runner.Selects(name))
+                    continue;
+
+                const auto directory = commandLine.workDir / (std::string(shape) + "-" + std::to_string(lineCount));
+                const auto project = shape == "wide" ? GenerateWideProject(directory, lineCount) : GenerateDeepProject(directory, lineCount);
+
+                // Compiled the way the CLI compiles to a file, with the generated code streamed to a sink.
+                Compiler::Compiler compiler;
+                runner.Run(name, "macro", project.workload, [&compiler, &project, &options]() {
+                    Compiler::NullSink sink;
+                    const auto unit = compiler.Compile(project.rootFile, options, sink);
+                    return unit.includedFiles.size();
+                });
+                std::filesystem::remove_all(directory);
+            }
+        }
+    }
+
+    void WriteJson(std::ostream& output, const CommandLine& commandLine, const std::vector<Measurement>& measurements)
+    {
+        output << std::fixed << std::setprecision(3);
+        output << "{\n";
+        output << "  \"version\": 1,\n";
+        output << "  \"quick\": " << (commandLine.quick ? "true" : "false") << ",\n";
+        output << "  \"benchmarks\": [";
+
+        for (std::size_t index = 0; index < measurements.size(); ++index)
+        {
+            const auto& measurement = measurements[index];
+            const double seconds = std::max(measurement.seconds, 1e-9);
+            const double iterations = static_cast<double>(measurement.iterations);
+
+            output << (index == 0 ? "\n" : ",\n");
+            output << "    {\n";
+            output << "      \"name\": \"" << measurement.name << "\",\n";
+            output << "      \"group\": \"" << measurement.group << "\",\n";
+            output << "      \"iterations\": " << measurement.iterations << ",\n";
+            output << "      \"bytes\": " << measurement.workload.bytes << ",\n";
+            output << "      \"tokens\": " << measurement.workload.tokens << ",\n";
+            output << "      \"lines\": " << measurement.workload.lines << ",\n";
+            output << "      \"millisecondsPerIteration\": " << seconds * 1000.0 / iterations << ",\n";
+            output << "      \"mbPerSecond\": " << static_cast<double>(measurement.workload.bytes) * iterations / (1024.0 * 1024.0) / seconds << ",\n";
+            output << "      \"tokensPerSecond\": " << static_cast<double>(measurement.workload.tokens) * iterations / seconds << "\n";
+            output << "    }";
+        }
+
+        output << (measurements.empty() ? "]\n" : "\n  ]\n");
+        output << "}\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto commandLine = ParseArguments(argc, argv);
+
+        std::filesystem::create_directories(commandLine.workDir);
+        const auto rulesFile = commandLine.workDir / "bench.tokens";
+        {
+            std::ofstream rules(rulesFile, std::ios::binary);
+            if (!rules.is_open())
+                throw std::runtime_error("Could not write " + rulesFile.string());
+            rules << kRules;
+        }
+
+        Runner runner(commandLine);
+        RunMicroBenchmarks(runner, rulesFile);
+        RunIncludeBenchmark(runner, commandLine.workDir);
+        RunMacroBenchmarks(runner, commandLine, rulesFile);
+
+        // Everything generated is gone by now; the directory itself goes only if nothing else lives in it.
+        std::filesystem::remove(rulesFile);
+        std::error_code ignored;
+        std::filesystem::remove(commandLine.workDir, ignored);
+
+        if (commandLine.outputFile.empty())
+        {
+            WriteJson(std::cout, commandLine, runner.GetMeasurements());
+            return EXIT_SUCCESS;
+        }
+
+        if (commandLine.outputFile.has_parent_path())
+            std::filesystem::create_directories(commandLine.outputFile.parent_path());
+
+        std::ofstream output(commandLine.outputFile);
+        if (!output.is_open())
+            throw std::runtime_error("Could not write " + commandLine.outputFile.string());
+        WriteJson(output, commandLine, runner.GetMeasurements());
+        std::cerr << "Wrote " << commandLine.outputFile.string() << '\n';
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << '\n';
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+}
@@ -1,13 +1,24 @@
+#include "AutoItPreprocessor/Common/ThreadPool.h"
+#include "AutoItPreprocessor/Compiler/BuildCache.h"
 #include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Compiler/OutputSink.h"
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_set>
 #include <vector>
 
 namespace
@@ -16,12 +27,16 @@ namespace
     {
         std::string command;
         std::filesystem::path inputFile;
+        std::vector<std::string> inputPatterns;
         std::filesystem::path outputFile;
+        std::filesystem::path outputDir;
+        std::filesystem::path cacheDir;
+        std::size_t jobs = 0;
         std::vector<std::filesystem::path> includeDirs;
         std::vector<std::filesystem::path> customFiles;
     };
 
-    std::string Escape(const std::string& content)
+    std::string Escape(std::string_view content)
     {
         std::string escaped;
         for (const char c : content)
@@ -44,7 +59,10 @@ namespace
             << "Usage:\n"
             << "  AutoItPreprocessor tokenize <input.au3> [--include-dir <dir>] [--custom <rules.tokens>]\n"
             << "  AutoItPreprocessor strip    <input.au3> [--out <output.au3>] [--include-dir <dir>]\n"
-            << "  AutoItPreprocessor compile  <input.au3> --out <output.au3> [--include-dir <dir>] [--custom <rules.tokens>]\n";
+            << "  AutoItPreprocessor compile  <input.au3> --out <output.au3> [--include-dir <dir>] [--custom <rules.tokens>] [--cache-dir <dir>]\n"
+            << "      strip and compile write to standard output with --out -.\n"
+            << "  AutoItPreprocessor compile-many <inputs...> --out-dir <dir> [--include-dir <dir>] [--custom <rules.tokens>] [--cache-dir <dir>] [--jobs <n>]\n"
+            << "      Inputs are files, wildcards such as scripts/*.au3, or @list.txt with one input per line.\n";
     }
 
     CommandLine ParseArguments(int argc, char** argv)
@@ -55,6 +73,7 @@ namespace
         CommandLine commandLine;
         commandLine.command = argv[1];
         commandLine.inputFile = argv[2];
+        commandLine.inputPatterns.emplace_back(argv[2]);
 
         for (int index = 3; index < argc; ++index)
         {
@@ -77,6 +96,32 @@ namespace
                     throw std::runtime_error("Missing path after --out");
                 commandLine.outputFile = argv[index];
             }
+            else if (arg == "--cache-dir")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing path after --cache-dir");
+                commandLine.cacheDir = argv[index];
+            }
+            else if (arg == "--out-dir")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing path after --out-dir");
+                commandLine.outputDir = argv[index];
+            }
+            else if (arg == "--jobs")
+            {
+                if (++index >= argc)
+                    throw std::runtime_error("Missing count after --jobs");
+
+                const std::string count = argv[index];
+                if (count.empty() || !std::all_of(count.begin(), count.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                    throw std::runtime_error("Invalid count after --jobs: " + count);
+                commandLine.jobs = std::stoul(count);
+            }
+            else if (commandLine.command == "compile-many" && !arg.starts_with("--"))
+            {
+                commandLine.inputPatterns.push_back(arg);
+            }
             else
             {
                 throw std::runtime_error("Unknown argument: " + arg);
@@ -86,16 +131,27 @@ namespace
         return commandLine;
     }
 
-    void WriteOutput(const std::filesystem::path& outputFile, const std::string& text)
+    bool IsStandardOutput(const std::filesystem::path& outputFile)
+    {
+        return outputFile == "-";
+    }
+
+    std::unique_ptr<AutoItPreprocessor::Compiler::FileSink> OpenOutput(const std::filesystem::path& outputFile)
     {
+        if (IsStandardOutput(outputFile))
+            return std::make_unique<AutoItPreprocessor::Compiler::FileSink>(std::cout);
+
         if (outputFile.has_parent_path())
             std::filesystem::create_directories(outputFile.parent_path());
 
-        std::ofstream output(outputFile);
-        if (!output.is_open())
-            throw std::runtime_error("Could not write output file: " + outputFile.string());
+        return std::make_unique<AutoItPreprocessor::Compiler::FileSink>(outputFile);
+    }
 
-        output << text;
+    void ReportWritten(const std::filesystem::path& outputFile, bool cached)
+    {
+        // The output itself owns standard output.
+        if (!IsStandardOutput(outputFile))
+            std::cout << "Wrote " << outputFile.string() << (cached ? " (cached)" : "") << '\n';
     }
 
     std::filesystem::path MakeStrippedOutputPath(const std::filesystem::path& inputFile)
@@ -103,6 +159,252 @@ namespace
         const auto extension = inputFile.has_extension() ? inputFile.extension().string() : std::string(".au3");
         return inputFile.parent_path() / (inputFile.stem().string() + "_stripped" + extension);
     }
+
+    struct CompileOutcome
+    {
+        bool cached = false;
+        std::size_t outputBytes = 0;
+    };
+
+    CompileOutcome CompileToFile(
+        const AutoItPreprocessor::Compiler::Compiler& compiler,
+        const std::filesystem::path& inputFile,
+        const std::filesystem::path& outputFile,
+        const AutoItPreprocessor::Compiler::CompilerOptions& options,
+        AutoItPreprocessor::Compiler::BuildCache* cache)
+    {
+        if (cache != nullptr)
+        {
+            if (const auto cachedFile = cache->Find(inputFile, options))
+            {
+                if (outputFile.has_parent_path())
+                    std::filesystem::create_directories(outputFile.parent_path());
+
+                std::filesystem::copy_file(*cachedFile, outputFile, std::filesystem::copy_options::overwrite_existing);
+                return {.cached = true, .outputBytes = static_cast<std::size_t>(std::filesystem::file_size(outputFile))};
+            }
+        }
+
+        if (IsStandardOutput(outputFile))
+        {
+            auto output = OpenOutput(outputFile);
+            static_cast<void>(compiler.Compile(inputFile, options, *output));
+            output->Flush();
+            return {.cached = false, .outputBytes = static_cast<std::size_t>(output->GetBytesWritten())};
+        }
+
+        // Streamed next to the output and renamed once complete, so a failing compile leaves an existing output as it was.
+        auto temporaryFile = outputFile;
+        temporaryFile += ".tmp";
+
+        AutoItPreprocessor::Compiler::CompilationUnit compilation;
+        std::size_t outputBytes = 0;
+        try
+        {
+            {
+                auto output = OpenOutput(temporaryFile);
+                compilation = compiler.Compile(inputFile, options, *output);
+                output->Flush();
+                outputBytes = static_cast<std::size_t>(output->GetBytesWritten());
+            }
+
+            std::filesystem::rename(temporaryFile, outputFile);
+        }
+        catch (...)
+        {
+            std::error_code error;
+            std::filesystem::remove(temporaryFile, error);
+            throw;
+        }
+
+        // Stored after writing so an output placed next to the sources is already part of the fingerprint.
+        if (cache != nullptr)
+            cache->Store(inputFile, options, compilation, outputFile);
+
+        return {.cached = false, .outputBytes = outputBytes};
+    }
+
+    bool MatchesWildcard(std::string_view name, std::string_view pattern) noexcept
+    {
+        std::size_t nameIndex = 0;
+        std::size_t patternIndex = 0;
+        std::size_t starIndex = std::string_view::npos;
+        std::size_t resumeIndex = 0;
+
+        while (nameIndex < name.size())
+        {
+            if (patternIndex < pattern.size() && (pattern[patternIndex] == '?' || pattern[patternIndex] == name[nameIndex]))
+            {
+                ++nameIndex;
+                ++patternIndex;
+            }
+            else if (patternIndex < pattern.size() && pattern[patternIndex] == '*')
+            {
+                starIndex = patternIndex++;
+                resumeIndex = nameIndex;
+            }
+            else if (starIndex != std::string_view::npos)
+            {
+                patternIndex = starIndex + 1U;
+                nameIndex = ++resumeIndex;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        while (patternIndex < pattern.size() && pattern[patternIndex] == '*')
+            ++patternIndex;
+
+        return patternIndex == pattern.size();
+    }
+
+    void ExpandInputPattern(const std::string& pattern, std::vector<std::filesystem::path>& inputs)
+    {
+        if (pattern.starts_with('@'))
+        {
+            const std::filesystem::path listFile = pattern.substr(1);
+            std::ifstream list(listFile);
+            if (!list.is_open())
+                throw std::runtime_error("Could not open input list: " + listFile.string());
+
+            std::string line;
+            while (std::getline(list, line))
+            {
+                const auto first = line.find_first_not_of(" \t\r");
+                if (first == std::string::npos)
+                    continue;
+
+                ExpandInputPattern(line.substr(first, line.find_last_not_of(" \t\r") + 1U - first), inputs);
+            }
+
+            return;
+        }
+
+        const std::filesystem::path path = pattern;
+        const auto namePattern = path.filename().string();
+        if (namePattern.find_first_of("*?") == std::string::npos)
+        {
+            inputs.push_back(path);
+            return;
+        }
+
+        // Wildcards are matched against file names in a single directory, in a stable order.
+        const auto directory = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+        std::vector<std::filesystem::path> matches;
+        std::error_code error;
+        for (std::filesystem::directory_iterator iterator(directory, error), end; !error && iterator != end; iterator.increment(error))
+        {
+            if (iterator->is_regular_file() && MatchesWildcard(iterator->path().filename().string(), namePattern))
+                matches.push_back(path.has_parent_path() ? iterator->path() : iterator->path().filename());
+        }
+
+        if (matches.empty())
+            throw std::runtime_error("No input files match " + pattern);
+
+        std::sort(matches.begin(), matches.end());
+        inputs.insert(inputs.end(), matches.begin(), matches.end());
+    }
+
+    int CompileMany(const CommandLine& commandLine, AutoItPreprocessor::Compiler::CompilerOptions options)
+    {
+        if (commandLine.outputDir.empty())
+            throw std::runtime_error("compile-many requires --out-dir <dir>");
+
+        std::vector<std::filesystem::path> inputs;
+        for (const auto& pattern : commandLine.inputPatterns)
+            ExpandInputPattern(pattern, inputs);
+
+        std::unordered_set<std::filesystem::path> outputNames;
+        for (const auto& input : inputs)
+        {
+            if (!outputNames.insert(input.filename()).second)
+                throw std::runtime_error("Several inputs would be written to " + (commandLine.outputDir / input.filename()).string());
+        }
+
+        // One compiler prepares the rules for the whole batch, up front so a bad rule file fails before any output is
+        // written; included files are shared through the process-wide include cache.
+        const AutoItPreprocessor::Compiler::Compiler compiler;
+        static_cast<void>(compiler.Prepare(options));
+        options.outputs = AutoItPreprocessor::Compiler::CompilerOutputs::None;
+
+        std::optional<AutoItPreprocessor::Compiler::BuildCache> cache;
+        if (!commandLine.cacheDir.empty())
+            cache.emplace(commandLine.cacheDir);
+
+        struct Result
+        {
+            CompileOutcome outcome;
+            double milliseconds = 0.0;
+            std::string error;
+        };
+
+        std::optional<AutoItPreprocessor::Common::ThreadPool> ownPool;
+        if (commandLine.jobs > 0)
+            ownPool.emplace(commandLine.jobs);
+        auto& pool = ownPool.has_value() ? *ownPool : AutoItPreprocessor::Common::ThreadPool::Shared();
+
+        std::filesystem::create_directories(commandLine.outputDir);
+
+        std::vector<Result> results(inputs.size());
+        const auto batchStart = std::chrono::steady_clock::now();
+        {
+            AutoItPreprocessor::Common::TaskGroup tasks(pool);
+            for (std::size_t index = 0; index < inputs.size(); ++index)
+            {
+                tasks.Run([&, index]
+                {
+                    auto& result = results[index];
+                    const auto start = std::chrono::steady_clock::now();
+                    try
+                    {
+                        result.outcome = CompileToFile(compiler, inputs[index], commandLine.outputDir / inputs[index].filename(), options, cache.has_value() ? &*cache : nullptr);
+                    }
+                    catch (const std::exception& exception)
+                    {
+                        result.error = exception.what();
+                    }
+
+                    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                });
+            }
+
+            tasks.Wait();
+        }
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+
+        std::size_t failed = 0;
+        std::size_t cached = 0;
+        std::size_t outputBytes = 0;
+        std::cout << std::fixed << std::setprecision(2);
+        for (std::size_t index = 0; index < inputs.size(); ++index)
+        {
+            const auto& result = results[index];
+            if (!result.error.empty())
+            {
+                ++failed;
+                std::cerr << "FAILED " << inputs[index].string() << ": " << result.error << '\n';
+                continue;
+            }
+
+            cached += result.outcome.cached ? 1U : 0U;
+            outputBytes += result.outcome.outputBytes;
+            std::cout
+                << std::setw(10) << result.milliseconds << " ms  "
+                << inputs[index].string() << " -> " << (commandLine.outputDir / inputs[index].filename()).string()
+                << (result.outcome.cached ? " (cached)" : "") << '\n';
+        }
+
+        const double safeSeconds = std::max(seconds, 1e-9);
+        std::cout
+            << "Compiled " << inputs.size() - failed << " of " << inputs.size() << " files (" << cached << " cached) in "
+            << seconds * 1000.0 << " ms on " << pool.GetThreadCount() << " threads: "
+            << static_cast<double>(inputs.size()) / safeSeconds << " files/s, "
+            << static_cast<double>(outputBytes) / (1024.0 * 1024.0) / safeSeconds << " MB/s generated\n";
+
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 }
 
 int main(int argc, char** argv)
@@ -115,38 +417,57 @@ int main(int argc, char** argv)
         AutoItPreprocessor::Compiler::CompilerOptions options;
         options.includeDirectories = commandLine.includeDirs;
         options.customRuleFiles = commandLine.customFiles;
-
-        const auto compilation = compiler.Compile(commandLine.inputFile, options);
-
+        // Each command asks for just what it prints; compile streams its code through a sink on top of that.
+        options.outputs = AutoItPreprocessor::Compiler::CompilerOutputs::None;
         if (commandLine.command == "tokenize")
+            options.outputs = AutoItPreprocessor::Compiler::CompilerOutputs::Tokens;
+        else if (commandLine.command == "strip")
+            options.outputs = AutoItPreprocessor::Compiler::CompilerOutputs::StrippedCode;
+
+        if (commandLine.command == "compile")
         {
-            for (const auto& token : compilation.tokens)
+            if (commandLine.outputFile.empty())
+                throw std::runtime_error("compile requires --out <output.au3>");
+
+            std::optional<AutoItPreprocessor::Compiler::BuildCache> cache;
+            if (!commandLine.cacheDir.empty())
             {
-                std::cout
-                    << std::setw(6) << token.GetLine() << "  "
-                    << std::setw(16) << AutoItPreprocessor::Tokenizer::ToString(token.GetKind()) << "  "
-                    << Escape(token.Is(AutoItPreprocessor::Tokenizer::TokenKind::Custom) ? token.GetReplacement() : token.GetContent())
-                    << '\n';
+                if (IsStandardOutput(commandLine.outputFile))
+                    throw std::runtime_error("--cache-dir needs an output file, not --out -");
+                cache.emplace(commandLine.cacheDir);
             }
 
+            const auto outcome = CompileToFile(compiler, commandLine.inputFile, commandLine.outputFile, options, cache.has_value() ? &*cache : nullptr);
+            ReportWritten(commandLine.outputFile, outcome.cached);
             return EXIT_SUCCESS;
         }
 
+        if (commandLine.command == "compile-many")
+            return CompileMany(commandLine, options);
+
+        const auto compilation = compiler.Compile(commandLine.inputFile, options);
+
         if (commandLine.command == "strip")
         {
             const auto outputPath = commandLine.outputFile.empty() ? MakeStrippedOutputPath(commandLine.inputFile) : commandLine.outputFile;
-            WriteOutput(outputPath, compilation.strippedCode);
-            std::cout << "Wrote " << outputPath.string() << '\n';
+            auto output = OpenOutput(outputPath);
+            output->Write(compilation.strippedCode);
+            output->Flush();
+            ReportWritten(outputPath, false);
             return EXIT_SUCCESS;
         }
 
-        if (commandLine.command == "compile")
+        if (commandLine.command == "tokenize")
         {
-            if (commandLine.outputFile.empty())
-                throw std::runtime_error("compile requires --out <output.au3>");
+            for (const auto& token : compilation.tokens)
+            {
+                std::cout
+                    << std::setw(6) << token.GetLine() << "  "
+                    << std::setw(16) << AutoItPreprocessor::Tokenizer::ToString(token.GetKind()) << "  "
+                    << Escape(token.Is(AutoItPreprocessor::Tokenizer::TokenKind::Custom) ? token.GetReplacement() : token.GetContent())
+                    << '\n';
+            }
 
-            WriteOutput(commandLine.outputFile, compilation.generatedCode);
-            std::cout << "Wrote " << commandLine.outputFile.string() << '\n';
             return EXIT_SUCCESS;
         }
 
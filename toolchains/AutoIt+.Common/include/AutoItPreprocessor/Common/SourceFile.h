@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace AutoItPreprocessor::Common
+{
+    // Read-only view of a source file on disk. The file is memory-mapped when possible and read into an owned
+    // buffer otherwise; either way GetText() excludes a leading UTF-8 byte order mark without copying.
+    class SourceFile
+    {
+    public:
+        SourceFile() = default;
+        explicit SourceFile(const std::filesystem::path& path);
+        SourceFile(SourceFile&& other) noexcept;
+        SourceFile& operator=(SourceFile&& other) noexcept;
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+        ~SourceFile();
+
+        [[nodiscard]] std::string_view GetText() const noexcept { return GetBytes().substr(m_BomOffset); }
+        [[nodiscard]] std::size_t GetBomOffset() const noexcept { return m_BomOffset; }
+        [[nodiscard]] bool IsMapped() const noexcept { return m_View != nullptr; }
+
+    private:
+        [[nodiscard]] std::string_view GetBytes() const noexcept;
+        bool TryMap(const std::filesystem::path& path);
+        void ReadIntoBuffer(const std::filesystem::path& path);
+        void Unmap() noexcept;
+
+        void* m_View = nullptr;
+        std::size_t m_ViewSize = 0;
+        std::string m_Buffer;
+        std::size_t m_BomOffset = 0;
+    };
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AutoItPreprocessor::Common
+{
+    // Fixed-size pool with one task deque per worker. Workers pop their own deque LIFO and steal FIFO from the
+    // others; tasks submitted from a worker land on that worker's deque.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(std::size_t threadCount = 0);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        [[nodiscard]] static ThreadPool& Shared();
+
+        [[nodiscard]] std::size_t GetThreadCount() const noexcept { return m_Threads.size(); }
+
+        void Submit(std::function<void()> task);
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void WorkerLoop(std::size_t index);
+        bool TryPop(std::size_t preferred, std::function<void()>& task);
+
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+        std::vector<std::thread> m_Threads;
+        std::mutex m_SleepMutex;
+        std::condition_variable m_WakeUp;
+        std::atomic<std::size_t> m_Queued = 0;
+        std::atomic<std::size_t> m_NextQueue = 0;
+        bool m_Stopping = false;
+    };
+
+    // Tracks a set of tasks on a pool. Tasks wait in the group's own queue and the pool only runs them on the group's
+    // behalf, so Wait() can run the group's leftover tasks itself without ever picking up unrelated pool work. That
+    // keeps it safe to call from inside another pool task, and rethrows the first exception a task raised.
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(ThreadPool& pool);
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        ~TaskGroup();
+
+        void Run(std::function<void()> task);
+        void Wait();
+
+    private:
+        // Shared with the pool tasks, which may still run after the group finished with an empty queue.
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable done;
+            std::deque<std::function<void()>> tasks;
+            std::size_t pending = 0;
+            std::exception_ptr error;
+
+            void RunQueued(std::function<void()> task) noexcept;
+        };
+
+        void WaitForPending() noexcept;
+
+        ThreadPool& m_Pool;
+        std::shared_ptr<State> m_State;
+    };
+}
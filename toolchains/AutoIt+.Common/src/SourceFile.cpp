@@ -0,0 +1,170 @@
+#include "AutoItPreprocessor/Common/SourceFile.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::size_t FindBomOffset(std::string_view bytes) noexcept
+    {
+        if (bytes.size() >= 3U
+            && static_cast<unsigned char>(bytes[0]) == 0xEF
+            && static_cast<unsigned char>(bytes[1]) == 0xBB
+            && static_cast<unsigned char>(bytes[2]) == 0xBF)
+        {
+            return 3U;
+        }
+
+        return 0U;
+    }
+}
+
+namespace AutoItPreprocessor::Common
+{
+    SourceFile::SourceFile(const std::filesystem::path& path)
+    {
+        if (!TryMap(path))
+            ReadIntoBuffer(path);
+
+        m_BomOffset = FindBomOffset(GetBytes());
+    }
+
+    SourceFile::SourceFile(SourceFile&& other) noexcept
+        : m_View(std::exchange(other.m_View, nullptr)),
+          m_ViewSize(std::exchange(other.m_ViewSize, 0U)),
+          m_Buffer(std::move(other.m_Buffer)),
+          m_BomOffset(std::exchange(other.m_BomOffset, 0U))
+    {
+    }
+
+    SourceFile& SourceFile::operator=(SourceFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Unmap();
+            m_View = std::exchange(other.m_View, nullptr);
+            m_ViewSize = std::exchange(other.m_ViewSize, 0U);
+            m_Buffer = std::move(other.m_Buffer);
+            m_BomOffset = std::exchange(other.m_BomOffset, 0U);
+        }
+
+        return *this;
+    }
+
+    SourceFile::~SourceFile()
+    {
+        Unmap();
+    }
+
+    std::string_view SourceFile::GetBytes() const noexcept
+    {
+        if (m_View != nullptr)
+            return std::string_view(static_cast<const char*>(m_View), m_ViewSize);
+
+        return m_Buffer;
+    }
+
+    bool SourceFile::TryMap(const std::filesystem::path& path)
+    {
+#if defined(_WIN32)
+        const HANDLE file = CreateFileW(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize = {};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return false;
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr)
+            return false;
+
+        m_View = view;
+        m_ViewSize = static_cast<std::size_t>(fileSize.QuadPart);
+        return true;
+#else
+        const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            return false;
+
+        struct stat status = {};
+        if (::fstat(file, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0)
+        {
+            ::close(file);
+            return false;
+        }
+
+        const auto size = static_cast<std::size_t>(status.st_size);
+        void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (view == MAP_FAILED)
+            return false;
+
+        m_View = view;
+        m_ViewSize = size;
+        return true;
+#endif
+    }
+
+    void SourceFile::ReadIntoBuffer(const std::filesystem::path& path)
+    {
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input.is_open())
+            throw std::runtime_error("Could not open source file: " + path.string());
+
+        const auto size = static_cast<std::streamoff>(input.tellg());
+        input.seekg(0, std::ios::beg);
+        if (size > 0)
+        {
+            m_Buffer.resize(static_cast<std::size_t>(size));
+            input.read(m_Buffer.data(), size);
+            m_Buffer.resize(static_cast<std::size_t>(input.gcount()));
+        }
+        else
+        {
+            m_Buffer.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+    }
+
+    void SourceFile::Unmap() noexcept
+    {
+        if (m_View == nullptr)
+            return;
+
+#if defined(_WIN32)
+        UnmapViewOfFile(m_View);
+#else
+        ::munmap(m_View, m_ViewSize);
+#endif
+        m_View = nullptr;
+        m_ViewSize = 0;
+    }
+}
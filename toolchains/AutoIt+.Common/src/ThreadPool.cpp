@@ -0,0 +1,213 @@
+#include "AutoItPreprocessor/Common/ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    constexpr std::size_t kNotAWorker = static_cast<std::size_t>(-1);
+
+    thread_local const void* t_CurrentPool = nullptr;
+    thread_local std::size_t t_WorkerIndex = kNotAWorker;
+}
+
+namespace AutoItPreprocessor::Common
+{
+    ThreadPool::ThreadPool(std::size_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1U, std::thread::hardware_concurrency());
+
+        m_Workers.reserve(threadCount);
+        for (std::size_t index = 0; index < threadCount; ++index)
+            m_Workers.push_back(std::make_unique<Worker>());
+
+        m_Threads.reserve(threadCount);
+        for (std::size_t index = 0; index < threadCount; ++index)
+            m_Threads.emplace_back([this, index] { WorkerLoop(index); });
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            const std::lock_guard lock(m_SleepMutex);
+            m_Stopping = true;
+        }
+
+        m_WakeUp.notify_all();
+        for (auto& thread : m_Threads)
+            thread.join();
+    }
+
+    ThreadPool& ThreadPool::Shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::Submit(std::function<void()> task)
+    {
+        const auto index = t_CurrentPool == this
+            ? t_WorkerIndex
+            : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % m_Workers.size();
+
+        // Counted before the task is visible, so a thief that pops it right away never takes the count below zero.
+        m_Queued.fetch_add(1);
+        try
+        {
+            auto& worker = *m_Workers[index];
+            const std::lock_guard lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+        catch (...)
+        {
+            m_Queued.fetch_sub(1);
+            throw;
+        }
+
+        {
+            const std::lock_guard lock(m_SleepMutex);
+        }
+
+        m_WakeUp.notify_one();
+    }
+
+    void ThreadPool::WorkerLoop(std::size_t index)
+    {
+        t_CurrentPool = this;
+        t_WorkerIndex = index;
+
+        while (true)
+        {
+            std::function<void()> task;
+            if (TryPop(index, task))
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock lock(m_SleepMutex);
+            m_WakeUp.wait(lock, [this] { return m_Stopping || m_Queued.load() > 0; });
+            if (m_Stopping && m_Queued.load() == 0)
+                return;
+        }
+    }
+
+    bool ThreadPool::TryPop(std::size_t preferred, std::function<void()>& task)
+    {
+        if (m_Queued.load() == 0)
+            return false;
+
+        {
+            auto& own = *m_Workers[preferred];
+            const std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                m_Queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        for (std::size_t offset = 1; offset < m_Workers.size(); ++offset)
+        {
+            auto& victim = *m_Workers[(preferred + offset) % m_Workers.size()];
+            const std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                m_Queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    TaskGroup::TaskGroup(ThreadPool& pool)
+        : m_Pool(pool),
+          m_State(std::make_shared<State>())
+    {
+    }
+
+    TaskGroup::~TaskGroup()
+    {
+        WaitForPending();
+    }
+
+    void TaskGroup::Run(std::function<void()> task)
+    {
+        {
+            const std::lock_guard lock(m_State->mutex);
+            m_State->tasks.push_back(std::move(task));
+            ++m_State->pending;
+        }
+
+        // Each pool task runs whatever the group still has queued. If the submit throws, the task stays queued and
+        // the waiter runs it, so the pending count always drains.
+        m_Pool.Submit([state = m_State]
+        {
+            std::unique_lock lock(state->mutex);
+            if (state->tasks.empty())
+                return;
+
+            auto queued = std::move(state->tasks.front());
+            state->tasks.pop_front();
+            lock.unlock();
+            state->RunQueued(std::move(queued));
+        });
+    }
+
+    void TaskGroup::Wait()
+    {
+        WaitForPending();
+
+        const std::lock_guard lock(m_State->mutex);
+        if (m_State->error)
+            std::rethrow_exception(std::exchange(m_State->error, nullptr));
+    }
+
+    void TaskGroup::WaitForPending() noexcept
+    {
+        std::unique_lock lock(m_State->mutex);
+        while (m_State->pending > 0)
+        {
+            // Only this group's own tasks are run here; anything already taken by a worker is simply waited for.
+            if (!m_State->tasks.empty())
+            {
+                auto queued = std::move(m_State->tasks.back());
+                m_State->tasks.pop_back();
+                lock.unlock();
+                m_State->RunQueued(std::move(queued));
+                lock.lock();
+                continue;
+            }
+
+            m_State->done.wait(lock);
+        }
+    }
+
+    void TaskGroup::State::RunQueued(std::function<void()> task) noexcept
+    {
+        std::exception_ptr taskError;
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            taskError = std::current_exception();
+        }
+
+        // Whatever the task captured is released before the waiter can return.
+        task = nullptr;
+
+        const std::lock_guard lock(mutex);
+        if (taskError && !error)
+            error = std::move(taskError);
+        if (--pending == 0)
+            done.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "AutoItPreprocessor/Compiler/Compiler.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace AutoItPreprocessor::Compiler
+{
+    // On-disk cache of generated code, one entry per root file and option set. An entry fingerprints every input
+    // file by content hash and every directory an include was looked up in by its listing, so it survives fresh
+    // checkouts. Files whose size and write time are unchanged are trusted without being read again. Entries keep
+    // a byte copy of the output file, so outputs are copied in and out without passing through memory whole.
+    class BuildCache
+    {
+    public:
+        explicit BuildCache(std::filesystem::path directory);
+
+        [[nodiscard]] const std::filesystem::path& GetDirectory() const noexcept { return m_Directory; }
+
+        // Returns the cached output file after checking it is intact.
+        [[nodiscard]] std::optional<std::filesystem::path> Find(const std::filesystem::path& inputFile, const CompilerOptions& options);
+        // `outputFile` holds the code generated for `unit`.
+        void Store(const std::filesystem::path& inputFile, const CompilerOptions& options, const CompilationUnit& unit, const std::filesystem::path& outputFile);
+
+    private:
+        struct FileFingerprint
+        {
+            std::filesystem::path path;
+            std::uint64_t hash = 0;
+            std::uintmax_t size = 0;
+            std::int64_t writeTime = 0;
+        };
+
+        struct DirectoryFingerprint
+        {
+            std::filesystem::path path;
+            std::uint64_t listingHash = 0;
+        };
+
+        struct Manifest
+        {
+            std::vector<FileFingerprint> files;
+            std::vector<DirectoryFingerprint> directories;
+            std::uint64_t outputHash = 0;
+            std::uintmax_t outputSize = 0;
+        };
+
+        [[nodiscard]] std::filesystem::path GetEntryPath(const std::filesystem::path& inputFile, const CompilerOptions& options) const;
+        [[nodiscard]] static std::optional<Manifest> ReadManifest(const std::filesystem::path& path);
+        static void WriteManifest(const std::filesystem::path& path, const Manifest& manifest);
+
+        std::filesystem::path m_Directory;
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "AutoItPreprocessor/Common/SourceDocument.h"
+#include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Compiler/IncludeResolver.h"
+#include "AutoItPreprocessor/Compiler/LineOriginTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace AutoItPreprocessor::Compiler
+{
+    // Replaces `length` bytes at `offset` of the root document with `replacement`.
+    struct TextEdit
+    {
+        std::size_t offset = 0;
+        std::size_t length = 0;
+        std::string replacement;
+    };
+
+    // Keeps the last CompilationUnit of one root document and patches it for edits. Only the token window around
+    // the edit is re-lexed, re-matched and re-emitted, and the include expansion is reused while no #include line
+    // changed and no included or rule file changed on disk. Anything else falls back to a full compile.
+    // Known limitation: the unit's buffers are still rebuilt whole on every edit. The merged text is copied into the
+    // stripped code and a new token source, and the token, span, generated code and line mapping vectors are spliced
+    // into fresh ones, so an update saves the lexing, matching and emitting but remains O(document) in copying.
+    class CompilationSession
+    {
+    public:
+        explicit CompilationSession(CompilerOptions options);
+
+        [[nodiscard]] const CompilerOptions& GetOptions() const noexcept { return m_Options; }
+        [[nodiscard]] const Common::SourceDocument& GetDocument() const noexcept { return m_Document; }
+        [[nodiscard]] const CompilationUnit& GetUnit() const noexcept { return m_Unit; }
+        [[nodiscard]] bool HasUnit() const noexcept { return m_HasUnit; }
+
+        const CompilationUnit& Compile(Common::SourceDocument document);
+        const CompilationUnit& Apply(const TextEdit& edit);
+        // Diffs the document against the previous text and applies the difference as a single edit.
+        const CompilationUnit& Update(const Common::SourceDocument& document);
+
+    private:
+        struct InputStamp
+        {
+            std::filesystem::path path;
+            std::filesystem::file_time_type writeTime;
+            std::uintmax_t size = 0;
+        };
+
+        struct EmittedSpan
+        {
+            std::size_t offset = 0;
+            std::size_t line = 1;
+        };
+
+        [[nodiscard]] bool InputsUnchanged() const;
+        [[nodiscard]] bool TryApplyIncrementally(const TextEdit& edit);
+        void RecordInputStamps();
+
+        CompilerOptions m_Options;
+        // Keeps the rules parsed across full recompiles until a rule file changes.
+        Compiler m_Compiler;
+        Common::SourceDocument m_Document;
+        CompilationUnit m_Unit;
+        LineOriginTable m_LineOrigins;
+        std::vector<IncludeExpansion> m_IncludeExpansions;
+        std::vector<EmittedSpan> m_EmittedSpans;
+        std::vector<InputStamp> m_InputStamps;
+        bool m_HasUnit = false;
+    };
+}
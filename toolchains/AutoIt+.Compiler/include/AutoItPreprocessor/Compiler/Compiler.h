@@ -2,22 +2,57 @@
 
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 #include "AutoItPreprocessor/Common/SourceDocument.h"
+#include "AutoItPreprocessor/Compiler/IncludeResolver.h"
+#include "AutoItPreprocessor/Compiler/LineOriginTable.h"
 
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace AutoItPreprocessor::Compiler
 {
+    class CustomBindingStore;
+    class CustomTokenRegistry;
+
+    // The CompilationUnit fields a compile fills in. Stages that no requested output needs are skipped: stripped
+    // code alone never lexes, and tokens alone never emit.
+    enum class CompilerOutputs : std::uint8_t
+    {
+        None = 0,
+        Tokens = 1U << 0U,
+        StrippedCode = 1U << 1U,
+        GeneratedCode = 1U << 2U,
+        LineMappings = 1U << 3U,
+        IncludeExpansions = 1U << 4U,
+        All = Tokens | StrippedCode | GeneratedCode | LineMappings | IncludeExpansions
+    };
+
+    [[nodiscard]] constexpr CompilerOutputs operator|(CompilerOutputs left, CompilerOutputs right) noexcept
+    {
+        return static_cast<CompilerOutputs>(static_cast<std::uint8_t>(left) | static_cast<std::uint8_t>(right));
+    }
+
+    [[nodiscard]] constexpr bool HasAnyOutput(CompilerOutputs outputs, CompilerOutputs wanted) noexcept
+    {
+        return (static_cast<std::uint8_t>(outputs) & static_cast<std::uint8_t>(wanted)) != 0U;
+    }
+
     struct CompilerOptions
     {
         std::vector<std::filesystem::path> includeDirectories;
         std::vector<std::filesystem::path> customRuleFiles;
+        CompilerOutputs outputs = CompilerOutputs::All;
+
+        [[nodiscard]] bool operator==(const CompilerOptions&) const = default;
     };
 
+    // sourceFile indexes CompilationUnit::includedFiles; index 0 is the root document.
     struct LineMapping
     {
-        std::filesystem::path sourcePath;
+        FileId sourceFile = 0;
         std::size_t sourceLine = 0;
         std::size_t mergedSourceLine = 0;
         std::size_t generatedLineStart = 0;
@@ -38,6 +73,11 @@ namespace AutoItPreprocessor::Compiler
     {
         std::filesystem::path rootPath;
         std::vector<std::filesystem::path> includedFiles;
+        // Set when the merged text was lexed; tokens point into it, into the rules' bindings and into the bindings
+        // expanded from their text.
+        std::shared_ptr<const std::string> tokenSource;
+        std::shared_ptr<const CustomTokenRegistry> customTokens;
+        std::shared_ptr<CustomBindingStore> customBindings;
         std::vector<Tokenizer::Token> tokens;
         std::string strippedCode;
         std::string generatedCode;
@@ -45,10 +85,47 @@ namespace AutoItPreprocessor::Compiler
         std::vector<GeneratedIncludeExpansion> includeExpansions;
     };
 
+    class OutputSink;
+
+    // What a Compiler derives from CompilerOptions before compiling anything.
+    struct PreparedOptions
+    {
+        IncludeSearchPath searchPath;
+        std::shared_ptr<const CustomTokenRegistry> customTokens;
+    };
+
+    // Keeps the rules and include search path prepared for the options it last compiled with, so a long-lived
+    // instance parses rule files again only after they change on disk. One instance can be shared between threads.
     class Compiler
     {
     public:
+        Compiler() = default;
+        Compiler(const Compiler&) = delete;
+        Compiler& operator=(const Compiler&) = delete;
+
         [[nodiscard]] CompilationUnit Compile(const std::filesystem::path& inputFile, const CompilerOptions& options) const;
         [[nodiscard]] CompilationUnit Compile(const Common::SourceDocument& inputDocument, const CompilerOptions& options) const;
+        // Streams the generated code to the sink, whatever options.outputs says; the unit's generatedCode stays empty.
+        [[nodiscard]] CompilationUnit Compile(const std::filesystem::path& inputFile, const CompilerOptions& options, OutputSink& sink) const;
+
+        // Without loadRules the rule files are neither read nor checked, and customTokens may be null.
+        [[nodiscard]] std::shared_ptr<const PreparedOptions> Prepare(const CompilerOptions& options, bool loadRules = true) const;
+
+    private:
+        struct RuleFileStamp
+        {
+            std::filesystem::file_time_type writeTime;
+            std::uintmax_t size = 0;
+
+            [[nodiscard]] bool operator==(const RuleFileStamp&) const = default;
+        };
+
+        [[nodiscard]] static std::vector<RuleFileStamp> StampRuleFiles(const std::vector<std::filesystem::path>& ruleFiles);
+
+        mutable std::mutex m_PreparedMutex;
+        mutable std::vector<std::filesystem::path> m_PreparedIncludeDirectories;
+        mutable std::vector<std::filesystem::path> m_PreparedRuleFiles;
+        mutable std::vector<RuleFileStamp> m_PreparedRuleStamps;
+        mutable std::shared_ptr<const PreparedOptions> m_Prepared;
     };
 }
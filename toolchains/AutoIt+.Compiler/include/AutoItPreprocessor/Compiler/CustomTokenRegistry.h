@@ -2,28 +2,164 @@
 
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <optional>
+#include <functional>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace AutoItPreprocessor::Compiler
 {
+    // A piece of an emit template: literal text, or the text captured by a pattern wildcard (0 is the whole token).
+    struct EmitPart
+    {
+        std::string text;
+        int capture = -1;
+    };
+
+    enum class PatternElementKind : std::uint8_t
+    {
+        Literal,
+        AnyOne,
+        AnyRun
+    };
+
+    // One step of a compiled match or pattern. A literal accepts either of two bytes so case-insensitive letters need
+    // no special handling in the automaton.
+    struct PatternElement
+    {
+        PatternElementKind kind = PatternElementKind::Literal;
+        unsigned char lower = 0;
+        unsigned char upper = 0;
+
+        [[nodiscard]] bool Accepts(unsigned char character) const noexcept
+        {
+            return kind != PatternElementKind::Literal || character == lower || character == upper;
+        }
+    };
+
     struct CustomTokenRule
     {
-        std::string name;
+        Tokenizer::CustomBinding binding;
+        // Exact token text, or a glob over it when isPattern is set: `*` matches any run, `?` any single character.
         std::string match;
-        std::string emit;
         std::vector<Tokenizer::TokenKind> allowedKinds;
+        std::vector<EmitPart> emit;
+        // `match` compiled once when the rule loads.
+        std::vector<PatternElement> pattern;
+        bool isPattern = false;
+        bool ignoreCase = false;
+        // The replacement depends on the matched text, so bindings are expanded per distinct token text.
+        bool capturesText = false;
     };
 
+    enum class SequenceElementKind : std::uint8_t
+    {
+        Token,
+        AnyToken,
+        Run
+    };
+
+    // One step of a sequence rule: a token of a kind (optionally with fixed text), any single token, or a run of
+    // tokens with balanced parentheses and brackets.
+    struct SequenceElement
+    {
+        SequenceElementKind kind = SequenceElementKind::Token;
+        Tokenizer::TokenKind tokenKind = Tokenizer::TokenKind::Word;
+        std::string text;
+    };
+
+    // Replaces several tokens of one line. Spaces, tabs, comments and line continuations between them are skipped
+    // while matching and replaced along with the tokens.
+    struct SequenceRule
+    {
+        Tokenizer::CustomBinding binding;
+        // Bound to every covered token after the first, so they emit nothing.
+        Tokenizer::CustomBinding consumed;
+        std::vector<SequenceElement> elements;
+        std::vector<EmitPart> emit;
+        bool ignoreCase = false;
+        bool capturesText = false;
+    };
+
+    // Bindings expanded from captured token text during one compile. Tokens point at them, so the compilation unit
+    // keeps its store next to its tokens; a store is only ever filled by one thread at a time.
+    class CustomBindingStore
+    {
+    private:
+        friend class CustomTokenRegistry;
+
+        struct TextHash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]] std::size_t operator()(std::string_view text) const noexcept { return std::hash<std::string_view>{}(text); }
+        };
+
+        std::unordered_map<std::string, std::unique_ptr<Tokenizer::CustomBinding>, TextHash, std::equal_to<>> m_Bindings;
+    };
+
+    // All rules targeting a token kind are compiled into one DFA over the token text, so matching walks the text
+    // once however many rules are loaded. A token whose kind no rule targets is rejected by a single bit test.
+    // When several rules accept a token, the first one loaded wins.
     class CustomTokenRegistry
     {
     public:
+        [[nodiscard]] static std::shared_ptr<const CustomTokenRegistry> LoadFromFiles(const std::vector<std::filesystem::path>& paths);
+
         void LoadFromFile(const std::filesystem::path& path);
-        [[nodiscard]] std::optional<CustomTokenRule> Match(const Tokenizer::Token& token) const;
+        // Bindings of rules that capture text are kept in `expansions`; the others live as long as the registry.
+        [[nodiscard]] const Tokenizer::CustomBinding* Match(const Tokenizer::Token& token, CustomBindingStore& expansions) const;
+
+        [[nodiscard]] bool HasSequences() const noexcept { return !m_Sequences.empty(); }
+        // Tries the sequence rules in load order at `position` of one line of tokens. On a match the covered tokens
+        // are rebound and their count is returned; otherwise nothing changes and 0 is returned.
+        std::size_t ApplySequence(std::span<Tokenizer::Token> line, std::size_t position, CustomBindingStore& expansions) const;
 
     private:
+        static constexpr std::size_t kKindCount = static_cast<std::size_t>(Tokenizer::TokenKind::Error) + 1U;
+        static_assert(kKindCount <= 64, "Targeted kinds are tracked in a 64-bit mask.");
+
+        static constexpr std::uint32_t kNoRule = UINT32_MAX;
+
+        struct Automaton
+        {
+            std::array<std::uint8_t, 256> byteClasses{};
+            std::size_t classCount = 1;
+            std::uint32_t start = 0;
+            // State 0 is the dead state; transitions are laid out as state * classCount + byte class.
+            std::vector<std::uint32_t> transitions;
+            std::vector<std::uint32_t> acceptedRules;
+        };
+
+        using TextHash = CustomBindingStore::TextHash;
+
+        void ParseFile(const std::filesystem::path& path);
+        void BuildAutomata();
+        [[nodiscard]] const Tokenizer::CustomBinding& Expand(std::uint32_t ruleIndex, std::string_view text, CustomBindingStore& expansions) const;
+        [[nodiscard]] const Tokenizer::CustomBinding& ExpandSequence(
+            std::uint32_t sequenceIndex,
+            const std::vector<std::string_view>& captures,
+            CustomBindingStore& expansions) const;
+
         std::vector<CustomTokenRule> m_Rules;
+        std::array<Automaton, kKindCount> m_Automata;
+        std::uint64_t m_TargetedKinds = 0;
+
+        // Sequences are looked up by their first token: by lowercased text when it is fixed, otherwise by kind alone.
+        struct SequenceHeads
+        {
+            std::unordered_map<std::string, std::vector<std::uint32_t>, TextHash, std::equal_to<>> byText;
+            std::vector<std::uint32_t> anyText;
+        };
+
+        std::vector<SequenceRule> m_Sequences;
+        std::array<SequenceHeads, kKindCount> m_SequenceHeads;
     };
 }
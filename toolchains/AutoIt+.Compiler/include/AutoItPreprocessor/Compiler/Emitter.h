@@ -1,8 +1,10 @@
 #pragma once
 
 #include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Compiler/OutputSink.h"
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -17,6 +19,29 @@ namespace AutoItPreprocessor::Compiler
     class Emitter
     {
     public:
-        [[nodiscard]] EmitResult Emit(const std::vector<Tokenizer::Token>& tokens) const;
+        Emitter() = default;
+        // Code goes to the sink as each token is appended and EmitResult::code stays empty. Without mapLines no line
+        // mappings are built and newlines are not counted.
+        explicit Emitter(OutputSink* sink, bool mapLines = true)
+            : m_Sink(sink)
+            , m_MapLines(mapLines)
+        {
+        }
+
+        // Appends every token and finishes, sizing the output exactly from the tokens before writing any of them.
+        [[nodiscard]] EmitResult Emit(const std::vector<Tokenizer::Token>& tokens);
+
+        // Sizes the output for a stream over `lineCount` source lines expected to emit about `codeSize` bytes.
+        void Reserve(std::size_t codeSize, std::size_t lineCount);
+        [[nodiscard]] bool MapsLines() const noexcept { return m_MapLines; }
+
+        void Append(const Tokenizer::Token& token);
+        [[nodiscard]] EmitResult Finish();
+
+    private:
+        OutputSink* m_Sink = nullptr;
+        bool m_MapLines = true;
+        EmitResult m_Result;
+        std::size_t m_GeneratedLine = 1;
     };
 }
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace AutoItPreprocessor::Compiler
+{
+    enum class SourceSegmentKind : std::uint8_t
+    {
+        Code,
+        Include
+    };
+
+    // A run of consecutive code lines, or a single #include directive, addressed by byte range into the source text.
+    struct SourceSegment
+    {
+        SourceSegmentKind kind = SourceSegmentKind::Code;
+        std::size_t offset = 0;
+        std::size_t length = 0;
+        std::size_t firstLine = 0;
+        std::size_t lineCount = 0;
+    };
+
+    struct SourceOutline
+    {
+        std::vector<SourceSegment> segments;
+        bool includeOnce = false;
+
+        [[nodiscard]] static SourceOutline Parse(std::string_view text);
+    };
+
+    struct CachedSource
+    {
+        std::string text;
+        SourceOutline outline;
+    };
+
+    // Process-wide cache of parsed include files keyed by canonical path. An entry is reused while the file's
+    // last write time and size are unchanged, so repeated compilations skip disk I/O for untouched includes.
+    class IncludeCache
+    {
+    public:
+        [[nodiscard]] static IncludeCache& Shared();
+
+        [[nodiscard]] std::shared_ptr<const CachedSource> Load(const std::filesystem::path& canonicalPath);
+        void Clear();
+
+    private:
+        struct Entry
+        {
+            std::filesystem::file_time_type writeTime;
+            std::uintmax_t size = 0;
+            std::shared_ptr<const CachedSource> source;
+        };
+
+        std::mutex m_Mutex;
+        std::unordered_map<std::filesystem::path, Entry> m_Entries;
+    };
+
+    // Directory modification times sampled at most once per instance. One instance lives for a single Resolve so
+    // every cached include lookup in that run is validated against the same snapshot.
+    class DirectoryStamps
+    {
+    public:
+        [[nodiscard]] std::filesystem::file_time_type Get(const std::filesystem::path& directory);
+
+    private:
+        std::mutex m_Mutex;
+        std::unordered_map<std::filesystem::path, std::filesystem::file_time_type> m_Stamps;
+    };
+
+    struct IncludePathResolution
+    {
+        std::optional<std::filesystem::path> path;
+        std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> probedDirectories;
+    };
+
+    // Process-wide memo of include lookups, including misses. An entry stays valid while none of the directories
+    // it probed has been modified, which covers files being added to or removed from the search path.
+    class IncludePathCache
+    {
+    public:
+        using Key = std::filesystem::path::string_type;
+
+        [[nodiscard]] static IncludePathCache& Shared();
+
+        [[nodiscard]] std::optional<IncludePathResolution> Find(const Key& key, DirectoryStamps& stamps);
+        void Store(Key key, IncludePathResolution resolution);
+        void Clear();
+
+    private:
+        std::mutex m_Mutex;
+        std::unordered_map<Key, IncludePathResolution> m_Entries;
+    };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace AutoItPreprocessor::Compiler
+{
+    enum class IncludeDirectiveKind : std::uint8_t
+    {
+        None,
+        Include,
+        IncludeOnce
+    };
+
+    struct IncludeDirective
+    {
+        IncludeDirectiveKind kind = IncludeDirectiveKind::None;
+        std::string_view text;
+        std::string_view name;
+        bool global = false;
+
+        [[nodiscard]] bool IsInclude() const noexcept { return kind == IncludeDirectiveKind::Include; }
+        [[nodiscard]] bool IsWellFormed() const noexcept { return !name.empty(); }
+    };
+
+    // Recognizes `#include-once`, `#include "name"` and `#include <name>` on a single source line, in any letter case as
+    // AutoIt does. The returned views point into the line; an #include whose target is not properly quoted has an empty name.
+    [[nodiscard]] IncludeDirective ScanIncludeDirective(std::string_view line) noexcept;
+}
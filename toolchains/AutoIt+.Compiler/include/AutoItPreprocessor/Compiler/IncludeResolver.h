@@ -1,20 +1,16 @@
 #pragma once
 
 #include "AutoItPreprocessor/Common/SourceDocument.h"
+#include "AutoItPreprocessor/Compiler/IncludeCache.h"
+#include "AutoItPreprocessor/Compiler/LineOriginTable.h"
 
 #include <filesystem>
 #include <string>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 
 namespace AutoItPreprocessor::Compiler
 {
-    struct ResolvedLineOrigin
-    {
-        std::filesystem::path path;
-        std::size_t line = 0;
-    };
-
     struct IncludeExpansion
     {
         std::filesystem::path sourcePath;
@@ -29,36 +25,55 @@ namespace AutoItPreprocessor::Compiler
     {
         Common::SourceDocument mergedDocument;
         std::vector<std::filesystem::path> includedFiles;
-        std::vector<ResolvedLineOrigin> lineOrigins;
+        LineOriginTable lineOrigins;
         std::vector<IncludeExpansion> includeExpansions;
     };
 
+    // The caller's include directories followed by the AutoIt installation's, without duplicates, and the key
+    // include lookups through them are cached under.
+    struct IncludeSearchPath
+    {
+        std::vector<std::filesystem::path> directories;
+        IncludePathCache::Key key;
+    };
+
     class IncludeResolver
     {
     public:
+        [[nodiscard]] static IncludeSearchPath PrepareSearchPath(const std::vector<std::filesystem::path>& includeDirectories);
+
         [[nodiscard]] IncludeResolveResult Resolve(const std::filesystem::path& rootPath, const std::vector<std::filesystem::path>& includeDirectories) const;
         [[nodiscard]] IncludeResolveResult Resolve(const Common::SourceDocument& rootDocument, const std::vector<std::filesystem::path>& includeDirectories) const;
+        [[nodiscard]] IncludeResolveResult Resolve(const std::filesystem::path& rootPath, const IncludeSearchPath& searchPath) const;
+        [[nodiscard]] IncludeResolveResult Resolve(const Common::SourceDocument& rootDocument, const IncludeSearchPath& searchPath) const;
 
     private:
-        struct ParseResult
-        {
-            std::string mergedCode;
-            std::vector<ResolvedLineOrigin> lineOrigins;
-            std::vector<IncludeExpansion> includeExpansions;
-            bool includeOnce = false;
-        };
+        struct IncludeNode;
+        struct IncludeGraph;
+        struct StitchState;
+
+        // Parses the root's outline unless the cache already has it.
+        [[nodiscard]] IncludeResolveResult ResolveRoot(
+            const std::filesystem::path& rootPath,
+            std::string_view text,
+            const SourceOutline* cachedOutline,
+            const IncludeSearchPath& searchPath) const;
+
+        void DiscoverIncludes(
+            IncludeGraph& graph,
+            IncludeNode& node,
+            const std::filesystem::path& filePath,
+            const std::vector<std::filesystem::path>& includeDirectories) const;
 
-        [[nodiscard]] ParseResult ResolveDocumentText(
+        void ResolveDocumentText(
             const std::filesystem::path& filePath,
-            const std::string& text,
-            const std::vector<std::filesystem::path>& includeDirectories,
-            std::unordered_set<std::filesystem::path>& seenFiles,
-            std::vector<std::filesystem::path>& includedFiles) const;
+            const IncludeNode& node,
+            const IncludeGraph& graph,
+            StitchState& state) const;
 
-        [[nodiscard]] ParseResult ResolveFile(
+        void ResolveFile(
             const std::filesystem::path& filePath,
-            const std::vector<std::filesystem::path>& includeDirectories,
-            std::unordered_set<std::filesystem::path>& seenFiles,
-            std::vector<std::filesystem::path>& includedFiles) const;
+            const IncludeGraph& graph,
+            StitchState& state) const;
     };
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace AutoItPreprocessor::Compiler
+{
+    using FileId = std::uint32_t;
+
+    struct LineOrigin
+    {
+        FileId file = 0;
+        std::size_t line = 0;
+    };
+
+    // A run of merged lines that come from consecutive lines of one source file.
+    struct LineOriginRange
+    {
+        FileId file = 0;
+        std::size_t mergedLineStart = 0;
+        std::size_t sourceLineStart = 0;
+        std::size_t lineCount = 0;
+    };
+
+    // Maps 1-based merged line numbers back to their source file and line. Storage grows with the number of
+    // include boundaries rather than the number of lines.
+    class LineOriginTable
+    {
+    public:
+        [[nodiscard]] FileId AddFile(const std::filesystem::path& path);
+        void AppendLines(FileId file, std::size_t sourceLineStart, std::size_t lineCount);
+        // Grows or shrinks the range holding `mergedLine` by `lineDelta` lines and shifts everything after it,
+        // including later source lines of the same file.
+        void SpliceLines(std::size_t mergedLine, std::ptrdiff_t lineDelta) noexcept;
+
+        [[nodiscard]] std::optional<LineOrigin> Find(std::size_t mergedLine) const noexcept;
+
+        [[nodiscard]] const std::filesystem::path& GetPath(FileId file) const noexcept { return m_Files[file]; }
+        [[nodiscard]] const std::vector<std::filesystem::path>& GetFiles() const noexcept { return m_Files; }
+        [[nodiscard]] const std::vector<LineOriginRange>& GetRanges() const noexcept { return m_Ranges; }
+        [[nodiscard]] std::size_t GetLineCount() const noexcept { return m_LineCount; }
+
+    private:
+        std::vector<std::filesystem::path> m_Files;
+        std::vector<LineOriginRange> m_Ranges;
+        std::size_t m_LineCount = 0;
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace AutoItPreprocessor::Compiler
+{
+    // Receives generated code as it is produced, so callers that only write it out never hold all of it.
+    class OutputSink
+    {
+    public:
+        virtual ~OutputSink() = default;
+
+        virtual void Write(std::string_view text) = 0;
+    };
+
+    class NullSink final : public OutputSink
+    {
+    public:
+        void Write(std::string_view) override {}
+    };
+
+    class StringSink final : public OutputSink
+    {
+    public:
+        explicit StringSink(std::string& text)
+            : m_Text(text)
+        {
+        }
+
+        void Write(std::string_view text) override { m_Text += text; }
+
+    private:
+        std::string& m_Text;
+    };
+
+    // Gathers small writes into large chunks before passing them to a file or an existing stream such as stdout.
+    // Files are opened in text mode, like the outputs written before sinks existed.
+    class FileSink final : public OutputSink
+    {
+    public:
+        static constexpr std::size_t kChunkSize = std::size_t{1} << 20;
+
+        explicit FileSink(const std::filesystem::path& path);
+        explicit FileSink(std::ostream& stream);
+        FileSink(const FileSink&) = delete;
+        FileSink& operator=(const FileSink&) = delete;
+        // Unflushed data is written on a best-effort basis; call Flush to see errors.
+        ~FileSink() override;
+
+        void Write(std::string_view text) override;
+        void Flush();
+
+        [[nodiscard]] std::uint64_t GetBytesWritten() const noexcept { return m_BytesWritten; }
+
+    private:
+        void WriteChunk(std::string_view chunk);
+
+        std::ofstream m_File;
+        std::ostream* m_Stream = nullptr;
+        std::string m_Description;
+        std::string m_Buffer;
+        std::uint64_t m_BytesWritten = 0;
+    };
+}
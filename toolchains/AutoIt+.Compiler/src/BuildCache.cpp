@@ -0,0 +1,339 @@
+#include "AutoItPreprocessor/Compiler/BuildCache.h"
+
+#include "AutoItPreprocessor/Common/SourceFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace AutoItPreprocessor::Compiler
+{
+    namespace
+    {
+        constexpr std::string_view kManifestHeader = "AutoItPreprocessor build cache 2";
+
+        // FNV-1a; the cache only needs to notice changes, not resist crafted collisions.
+        class Hasher
+        {
+        public:
+            void Add(std::string_view bytes) noexcept
+            {
+                for (const char character : bytes)
+                {
+                    m_Value ^= static_cast<unsigned char>(character);
+                    m_Value *= 0x100000001b3ULL;
+                }
+            }
+
+            void AddField(std::string_view bytes) noexcept
+            {
+                Add(bytes);
+                Add(std::string_view("\0", 1));
+            }
+
+            [[nodiscard]] std::uint64_t GetValue() const noexcept { return m_Value; }
+
+        private:
+            std::uint64_t m_Value = 0xcbf29ce484222325ULL;
+        };
+
+        std::string ToHex(std::uint64_t value)
+        {
+            char buffer[17];
+            std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+            return buffer;
+        }
+
+        std::filesystem::path Normalize(const std::filesystem::path& path)
+        {
+            return std::filesystem::absolute(path).lexically_normal();
+        }
+
+        std::uint64_t HashFile(const std::filesystem::path& path)
+        {
+            const Common::SourceFile file(path);
+            Hasher hasher;
+            hasher.Add(file.GetText());
+            return hasher.GetValue();
+        }
+
+        // Hashes the raw bytes in chunks; outputs can be far larger than anything worth reading whole.
+        std::optional<std::uint64_t> HashOutputFile(const std::filesystem::path& path)
+        {
+            std::ifstream input(path, std::ios::binary);
+            if (!input.is_open())
+                return std::nullopt;
+
+            Hasher hasher;
+            std::string chunk(std::size_t{1} << 16, '\0');
+            while (input.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || input.gcount() > 0)
+                hasher.Add(std::string_view(chunk.data(), static_cast<std::size_t>(input.gcount())));
+            if (input.bad())
+                return std::nullopt;
+
+            return hasher.GetValue();
+        }
+
+        // Only entry names decide how an include resolves, so a fresh checkout with new timestamps still matches.
+        // A missing directory hashes to 0, which an existing one never does.
+        std::uint64_t HashDirectoryListing(const std::filesystem::path& directory)
+        {
+            std::error_code error;
+            std::vector<std::string> names;
+            for (std::filesystem::directory_iterator iterator(directory, error), end; !error && iterator != end; iterator.increment(error))
+                names.push_back(iterator->path().filename().string());
+            if (error)
+                return 0;
+
+            std::sort(names.begin(), names.end());
+            Hasher hasher;
+            for (const auto& name : names)
+                hasher.AddField(name);
+
+            return hasher.GetValue();
+        }
+
+        std::int64_t GetWriteTime(const std::filesystem::path& path, std::error_code& error)
+        {
+            return static_cast<std::int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        }
+
+        void WriteFileAtomically(const std::filesystem::path& path, std::string_view content)
+        {
+            auto temporaryPath = path;
+            temporaryPath += ".tmp";
+            {
+                std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+                if (!output.is_open() || !output.write(content.data(), static_cast<std::streamsize>(content.size())))
+                    throw std::runtime_error("Could not write build cache file: " + temporaryPath.string());
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporaryPath, path, error);
+            if (error)
+                throw std::runtime_error("Could not write build cache file: " + path.string());
+        }
+
+        void CopyFileAtomically(const std::filesystem::path& source, const std::filesystem::path& path)
+        {
+            auto temporaryPath = path;
+            temporaryPath += ".tmp";
+
+            std::error_code error;
+            std::filesystem::copy_file(source, temporaryPath, std::filesystem::copy_options::overwrite_existing, error);
+            if (!error)
+                std::filesystem::rename(temporaryPath, path, error);
+            if (error)
+                throw std::runtime_error("Could not write build cache file: " + path.string());
+        }
+    }
+
+    BuildCache::BuildCache(std::filesystem::path directory)
+        : m_Directory(std::move(directory))
+    {
+    }
+
+    std::optional<std::filesystem::path> BuildCache::Find(const std::filesystem::path& inputFile, const CompilerOptions& options)
+    {
+        const auto entryPath = GetEntryPath(inputFile, options);
+        auto manifestPath = entryPath;
+        manifestPath += ".manifest";
+        auto outputPath = entryPath;
+        outputPath += ".out";
+
+        auto manifest = ReadManifest(manifestPath);
+        if (!manifest.has_value())
+            return std::nullopt;
+
+        bool restamped = false;
+        for (auto& file : manifest->files)
+        {
+            std::error_code error;
+            const auto size = std::filesystem::file_size(file.path, error);
+            const auto writeTime = error ? std::int64_t{0} : GetWriteTime(file.path, error);
+            if (error || size != file.size)
+                return std::nullopt;
+            if (writeTime == file.writeTime)
+                continue;
+
+            if (HashFile(file.path) != file.hash)
+                return std::nullopt;
+
+            file.writeTime = writeTime;
+            restamped = true;
+        }
+
+        for (const auto& directory : manifest->directories)
+        {
+            if (HashDirectoryListing(directory.path) != directory.listingHash)
+                return std::nullopt;
+        }
+
+        std::error_code outputError;
+        if (std::filesystem::file_size(outputPath, outputError) != manifest->outputSize || outputError || HashOutputFile(outputPath) != manifest->outputHash)
+            return std::nullopt;
+
+        // Content matched under new timestamps; remember them so the next lookup needs only a stat per file.
+        if (restamped)
+            WriteManifest(manifestPath, *manifest);
+
+        return outputPath;
+    }
+
+    void BuildCache::Store(const std::filesystem::path& inputFile, const CompilerOptions& options, const CompilationUnit& unit, const std::filesystem::path& outputFile)
+    {
+        // Created before any listing is taken, in case the cache lives next to the sources.
+        std::error_code directoryError;
+        std::filesystem::create_directories(m_Directory, directoryError);
+        if (directoryError)
+            throw std::runtime_error("Could not create build cache directory: " + m_Directory.string());
+
+        Manifest manifest;
+        std::error_code outputError;
+        const auto outputHash = HashOutputFile(outputFile);
+        manifest.outputSize = std::filesystem::file_size(outputFile, outputError);
+        if (!outputHash.has_value() || outputError)
+            return;
+        manifest.outputHash = *outputHash;
+
+        auto inputFiles = unit.includedFiles;
+        inputFiles.insert(inputFiles.end(), options.customRuleFiles.begin(), options.customRuleFiles.end());
+        for (const auto& file : inputFiles)
+        {
+            std::error_code error;
+            const auto path = Normalize(file);
+            const auto size = std::filesystem::file_size(path, error);
+            const auto writeTime = error ? std::int64_t{0} : GetWriteTime(path, error);
+            if (error)
+                return;
+
+            manifest.files.push_back(FileFingerprint{path, HashFile(path), size, writeTime});
+        }
+
+        // A new file in any of these directories could shadow an include that resolved elsewhere.
+        std::vector<std::filesystem::path> directories;
+        for (const auto& directory : options.includeDirectories)
+            directories.push_back(Normalize(directory));
+        for (const auto& file : unit.includedFiles)
+            directories.push_back(Normalize(file).parent_path());
+        std::sort(directories.begin(), directories.end());
+        directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+
+        for (auto& directory : directories)
+        {
+            const auto listingHash = HashDirectoryListing(directory);
+            manifest.directories.push_back(DirectoryFingerprint{std::move(directory), listingHash});
+        }
+
+        const auto entryPath = GetEntryPath(inputFile, options);
+        auto manifestPath = entryPath;
+        manifestPath += ".manifest";
+        auto outputPath = entryPath;
+        outputPath += ".out";
+
+        // The manifest carries the output hash, so a reader racing this write sees a mismatch rather than torn data.
+        CopyFileAtomically(outputFile, outputPath);
+        WriteManifest(manifestPath, manifest);
+    }
+
+    std::filesystem::path BuildCache::GetEntryPath(const std::filesystem::path& inputFile, const CompilerOptions& options) const
+    {
+        Hasher hasher;
+        hasher.AddField(kManifestHeader);
+        hasher.AddField(std::filesystem::weakly_canonical(inputFile).string());
+        for (const auto& directory : options.includeDirectories)
+        {
+            hasher.AddField("include");
+            hasher.AddField(Normalize(directory).string());
+        }
+        for (const auto& ruleFile : options.customRuleFiles)
+        {
+            hasher.AddField("rules");
+            hasher.AddField(Normalize(ruleFile).string());
+        }
+
+        return m_Directory / (inputFile.stem().string() + "-" + ToHex(hasher.GetValue()));
+    }
+
+    std::optional<BuildCache::Manifest> BuildCache::ReadManifest(const std::filesystem::path& path)
+    {
+        std::ifstream input(path, std::ios::binary);
+        std::string line;
+        if (!input.is_open() || !std::getline(input, line) || line != kManifestHeader)
+            return std::nullopt;
+
+        // Each record lists its fixed fields first and a path, which may contain spaces, as the rest of the line.
+        const auto readPath = [](std::istringstream& fields)
+        {
+            std::string path;
+            fields.get();
+            std::getline(fields, path);
+            return std::filesystem::path(path);
+        };
+
+        Manifest manifest;
+        bool hasOutput = false;
+        while (std::getline(input, line))
+        {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "output")
+            {
+                fields >> std::hex >> manifest.outputHash >> std::dec >> manifest.outputSize;
+                hasOutput = !fields.fail();
+            }
+            else if (kind == "file")
+            {
+                FileFingerprint file;
+                if (!(fields >> std::hex >> file.hash >> std::dec >> file.size >> file.writeTime))
+                    return std::nullopt;
+
+                file.path = readPath(fields);
+                if (file.path.empty())
+                    return std::nullopt;
+
+                manifest.files.push_back(std::move(file));
+            }
+            else if (kind == "directory")
+            {
+                DirectoryFingerprint directory;
+                if (!(fields >> std::hex >> directory.listingHash >> std::dec))
+                    return std::nullopt;
+
+                directory.path = readPath(fields);
+                if (directory.path.empty())
+                    return std::nullopt;
+
+                manifest.directories.push_back(std::move(directory));
+            }
+            else
+            {
+                return std::nullopt;
+            }
+        }
+
+        if (!hasOutput)
+            return std::nullopt;
+
+        return manifest;
+    }
+
+    void BuildCache::WriteManifest(const std::filesystem::path& path, const Manifest& manifest)
+    {
+        std::ostringstream output;
+        output << kManifestHeader << '\n';
+        output << "output " << ToHex(manifest.outputHash) << ' ' << manifest.outputSize << '\n';
+        for (const auto& file : manifest.files)
+            output << "file " << ToHex(file.hash) << ' ' << file.size << ' ' << file.writeTime << ' ' << file.path.string() << '\n';
+        for (const auto& directory : manifest.directories)
+            output << "directory " << ToHex(directory.listingHash) << ' ' << directory.path.string() << '\n';
+
+        WriteFileAtomically(path, output.str());
+    }
+}
@@ -0,0 +1,453 @@
+#include "AutoItPreprocessor/Compiler/CompilationSession.h"
+
+#include "CompilePasses.h"
+
+#include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
+#include "AutoItPreprocessor/Compiler/Emitter.h"
+#include "AutoItPreprocessor/Compiler/IncludeDirective.h"
+#include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace AutoItPreprocessor::Compiler
+{
+    namespace
+    {
+        using Tokenizer::Token;
+        using Tokenizer::TokenKind;
+
+        using Passes::CountNewlines;
+
+        std::size_t Shift(std::size_t value, std::ptrdiff_t delta) noexcept
+        {
+            return static_cast<std::size_t>(static_cast<std::ptrdiff_t>(value) + delta);
+        }
+
+        std::string_view EmittedText(const Token& token) noexcept
+        {
+            if (token.Is(TokenKind::End))
+                return {};
+
+            return token.Is(TokenKind::Custom) ? token.GetReplacement() : token.GetContent();
+        }
+
+        bool ContainsDirective(std::string_view text) noexcept
+        {
+            std::size_t position = 0;
+            while (position <= text.size())
+            {
+                const auto lineEnd = text.find('\n', position);
+                const auto line = text.substr(position, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - position);
+                if (ScanIncludeDirective(line).kind != IncludeDirectiveKind::None)
+                    return true;
+                if (lineEnd == std::string_view::npos)
+                    break;
+
+                position = lineEnd + 1U;
+            }
+
+            return false;
+        }
+    }
+
+    CompilationSession::CompilationSession(CompilerOptions options)
+        : m_Options(std::move(options))
+    {
+        // Incremental updates patch every output of the previous unit.
+        m_Options.outputs = CompilerOutputs::All;
+    }
+
+    const CompilationUnit& CompilationSession::Compile(Common::SourceDocument document)
+    {
+        m_HasUnit = false;
+        m_Document = std::move(document);
+
+        const auto prepared = m_Compiler.Prepare(m_Options);
+        Passes::ResolvedOrigins origins;
+        m_Unit = Passes::CompileResolved(IncludeResolver().Resolve(m_Document, prepared->searchPath), *prepared, m_Options.outputs, nullptr, &origins);
+        m_LineOrigins = std::move(origins.lineOrigins);
+        m_IncludeExpansions = std::move(origins.includeExpansions);
+
+        m_EmittedSpans.clear();
+        m_EmittedSpans.reserve(m_Unit.tokens.size());
+        EmittedSpan span;
+        for (const auto& token : m_Unit.tokens)
+        {
+            m_EmittedSpans.push_back(span);
+            const auto text = EmittedText(token);
+            span.offset += text.size();
+            span.line += CountNewlines(text);
+        }
+
+        RecordInputStamps();
+        m_HasUnit = true;
+        return m_Unit;
+    }
+
+    const CompilationUnit& CompilationSession::Apply(const TextEdit& edit)
+    {
+        if (edit.offset > m_Document.text.size() || edit.length > m_Document.text.size() - edit.offset)
+            throw std::out_of_range("Text edit lies outside the document.");
+
+        if (m_HasUnit && TryApplyIncrementally(edit))
+            return m_Unit;
+
+        m_Document.text.replace(edit.offset, edit.length, edit.replacement);
+        return Compile(std::move(m_Document));
+    }
+
+    const CompilationUnit& CompilationSession::Update(const Common::SourceDocument& document)
+    {
+        if (!m_HasUnit || document.path != m_Document.path)
+            return Compile(document);
+
+        const std::string_view previous = m_Document.text;
+        const std::string_view current = document.text;
+        const auto limit = std::min(previous.size(), current.size());
+
+        std::size_t prefix = 0;
+        while (prefix < limit && previous[prefix] == current[prefix])
+            ++prefix;
+
+        std::size_t suffix = 0;
+        while (suffix < limit - prefix && previous[previous.size() - 1U - suffix] == current[current.size() - 1U - suffix])
+            ++suffix;
+
+        if (prefix == previous.size() && prefix == current.size())
+            return InputsUnchanged() ? m_Unit : Compile(document);
+
+        return Apply(TextEdit{
+            .offset = prefix,
+            .length = previous.size() - prefix - suffix,
+            .replacement = std::string(current.substr(prefix, current.size() - prefix - suffix))
+        });
+    }
+
+    bool CompilationSession::InputsUnchanged() const
+    {
+        for (const auto& stamp : m_InputStamps)
+        {
+            std::error_code error;
+            const auto writeTime = std::filesystem::last_write_time(stamp.path, error);
+            if (error || writeTime != stamp.writeTime)
+                return false;
+
+            if (!std::filesystem::is_directory(stamp.path, error) && std::filesystem::file_size(stamp.path, error) != stamp.size)
+                return false;
+        }
+
+        return true;
+    }
+
+    void CompilationSession::RecordInputStamps()
+    {
+        m_InputStamps.clear();
+
+        const auto record = [this](const std::filesystem::path& path)
+        {
+            std::error_code error;
+            const auto writeTime = std::filesystem::last_write_time(path, error);
+            if (error)
+                return;
+
+            const auto size = std::filesystem::is_directory(path, error) ? std::uintmax_t{0} : std::filesystem::file_size(path, error);
+            m_InputStamps.push_back(InputStamp{path, writeTime, error ? std::uintmax_t{0} : size});
+        };
+
+        // Directory stamps catch a new file shadowing an include that already resolved elsewhere.
+        for (const auto& includeDirectory : m_Options.includeDirectories)
+            record(includeDirectory);
+        for (const auto& ruleFile : m_Options.customRuleFiles)
+            record(ruleFile);
+        for (std::size_t index = 0; index < m_Unit.includedFiles.size(); ++index)
+        {
+            if (index > 0)
+                record(m_Unit.includedFiles[index]);
+            record(m_Unit.includedFiles[index].parent_path());
+        }
+    }
+
+    bool CompilationSession::TryApplyIncrementally(const TextEdit& edit)
+    {
+        const std::string_view root = m_Document.text;
+        const auto& oldTokens = m_Unit.tokens;
+        const std::string_view oldMerged = *m_Unit.tokenSource;
+
+        // An edit that reaches the end of the document can change whether the last line is newline-terminated,
+        // which the include resolver normalizes; lexer errors end the token stream early. Both recompile.
+        if (edit.offset + edit.length >= root.size() || oldTokens.empty() || !oldTokens.back().Is(TokenKind::End))
+            return false;
+
+        const auto previousNewline = edit.offset == 0 ? std::string_view::npos : root.rfind('\n', edit.offset - 1U);
+        const std::size_t lineStart = previousNewline == std::string_view::npos ? 0 : previousNewline + 1U;
+        const auto rootLineEnd = root.find('\n', edit.offset + edit.length);
+        const std::size_t lineEnd = rootLineEnd == std::string_view::npos ? root.size() : rootLineEnd;
+
+        const auto removed = root.substr(edit.offset, edit.length);
+        std::string editedLines;
+        editedLines.reserve(lineEnd - lineStart + edit.replacement.size());
+        editedLines += root.substr(lineStart, edit.offset - lineStart);
+        editedLines += edit.replacement;
+        editedLines += root.substr(edit.offset + edit.length, lineEnd - edit.offset - edit.length);
+        if (ContainsDirective(root.substr(lineStart, lineEnd - lineStart)) || ContainsDirective(editedLines))
+            return false;
+
+        if (!InputsUnchanged())
+            return false;
+
+        // The touched root lines are plain code, so they sit in one run of the merged document.
+        const std::size_t firstRootLine = CountNewlines(root.substr(0, lineStart)) + 1U;
+        const std::size_t lastRootLine = firstRootLine + CountNewlines(root.substr(lineStart, edit.offset + edit.length - lineStart));
+        const auto& ranges = m_LineOrigins.GetRanges();
+        const auto range = std::find_if(ranges.begin(), ranges.end(), [&](const LineOriginRange& candidate)
+        {
+            return candidate.file == 0
+                && candidate.sourceLineStart <= firstRootLine
+                && lastRootLine < candidate.sourceLineStart + candidate.lineCount;
+        });
+        if (range == ranges.end())
+            return false;
+
+        const std::size_t mergedLine = range->mergedLineStart + (firstRootLine - range->sourceLineStart);
+
+        // Line feed tokens carry their own line, unlike multi-line strings and comments, so the offset of the edited
+        // line is found by walking forward from the last line feed before it.
+        auto anchor = std::lower_bound(oldTokens.begin(), oldTokens.end(), mergedLine, [](const Token& token, std::size_t line)
+        {
+            return token.GetLine() < line;
+        });
+        while (anchor != oldTokens.begin() && !std::prev(anchor)->Is(TokenKind::LineFeed))
+            --anchor;
+
+        std::size_t mergedLineStart = 0;
+        std::size_t anchorLine = 1;
+        if (anchor != oldTokens.begin())
+        {
+            mergedLineStart = std::prev(anchor)->GetEnd();
+            anchorLine = std::prev(anchor)->GetLine() + 1U;
+        }
+        for (; anchorLine < mergedLine; ++anchorLine)
+        {
+            const auto newline = oldMerged.find('\n', mergedLineStart);
+            if (newline == std::string_view::npos)
+                return false;
+
+            mergedLineStart = newline + 1U;
+        }
+
+        // The touched lines are copied verbatim into the merged text; checking all of them also covers insertions.
+        const auto touchedLines = root.substr(lineStart, lineEnd - lineStart);
+        if (oldMerged.substr(mergedLineStart, touchedLines.size()) != touchedLines)
+            return false;
+
+        const std::size_t editStart = mergedLineStart + (edit.offset - lineStart);
+        const std::size_t editEnd = editStart + edit.replacement.size();
+        const auto lineDelta = static_cast<std::ptrdiff_t>(CountNewlines(edit.replacement)) - static_cast<std::ptrdiff_t>(CountNewlines(removed));
+        const auto byteDelta = static_cast<std::ptrdiff_t>(edit.replacement.size()) - static_cast<std::ptrdiff_t>(edit.length);
+
+        // Tokens view the token source and the unit hands out the stripped code, so both still hold a full copy.
+        std::string strippedCode;
+        strippedCode.reserve(Shift(oldMerged.size(), byteDelta));
+        strippedCode.append(oldMerged, 0, editStart);
+        strippedCode += edit.replacement;
+        strippedCode.append(oldMerged, editStart + edit.length);
+        auto tokenSource = std::make_shared<const std::string>(strippedCode);
+        const std::string_view merged = *tokenSource;
+
+        // Re-lex from the start of the logical line holding the edit until the stream lines up with an old token that
+        // also begins a logical line past the edit; from there the old tokens are reused with shifted positions.
+        std::size_t first = static_cast<std::size_t>(std::prev(std::upper_bound(oldTokens.begin(), oldTokens.end(), editStart, [](std::size_t offset, const Token& token)
+        {
+            return offset < token.GetStart();
+        })) - oldTokens.begin());
+        while (first > 0 && (!oldTokens[first - 1U].Is(TokenKind::LineFeed) || Passes::ContinuesLine(oldTokens, first - 1U)))
+            --first;
+
+        // A multi-line token reports the line it ends on, so the window's first line comes from the line feed before it.
+        const std::size_t windowLine = first == 0 ? 1U : oldTokens[first - 1U].GetLine() + 1U;
+        Tokenizer::Tokenizer tokenizer(merged);
+        tokenizer.Seek(oldTokens[first].GetStart(), 1);
+
+        // Bindings the window no longer uses stay in the store until the next full compile replaces it.
+        Passes::RuleRewriter rewriter(*m_Unit.customTokens, *m_Unit.customBindings);
+        std::vector<Token> window;
+        const auto collect = [&window](const Token& token)
+        {
+            window.push_back(token);
+        };
+        std::size_t resync = oldTokens.size();
+        std::size_t candidate = first;
+        bool atLineStart = true;
+        bool continued = false;
+        while (true)
+        {
+            const auto token = tokenizer.Next();
+
+            // Compared before rules apply: from a line start, equal text lexes to equal tokens whatever they bind to.
+            if (atLineStart && token.GetStart() >= editEnd)
+            {
+                const std::size_t oldStart = token.GetStart() - edit.replacement.size() + edit.length;
+                while (candidate < oldTokens.size() && oldTokens[candidate].GetStart() < oldStart)
+                    ++candidate;
+
+                if (candidate < oldTokens.size() && candidate > 0)
+                {
+                    const auto& old = oldTokens[candidate];
+                    if (old.GetStart() == oldStart
+                        && old.GetContent().size() == token.GetContent().size()
+                        && oldTokens[candidate - 1U].Is(TokenKind::LineFeed)
+                        && !Passes::ContinuesLine(oldTokens, candidate - 1U)
+                        && Shift(old.GetLine(), lineDelta) == token.GetLine() + windowLine - 1U)
+                    {
+                        resync = candidate;
+                        break;
+                    }
+                }
+            }
+
+            rewriter.Push(token, collect);
+            atLineStart = token.Is(TokenKind::LineFeed) && !continued;
+            continued = token.Is(TokenKind::Multiline)
+                || (continued && (token.Is(TokenKind::Space) || token.Is(TokenKind::Tab) || token.Is(TokenKind::Comment)));
+            if (token.Is(TokenKind::End) || token.Is(TokenKind::Error))
+                break;
+        }
+        rewriter.Flush(collect);
+
+        auto windowResult = Emitter().Emit(window);
+
+        const auto& oldSpans = m_EmittedSpans;
+        const auto windowSpan = oldSpans[first];
+        const std::size_t suffixOffset = resync < oldTokens.size() ? oldSpans[resync].offset : m_Unit.generatedCode.size();
+        const std::size_t windowGeneratedLines = CountNewlines(windowResult.code);
+        const auto generatedByteDelta = static_cast<std::ptrdiff_t>(windowSpan.offset + windowResult.code.size()) - static_cast<std::ptrdiff_t>(suffixOffset);
+        const auto generatedLineDelta = resync < oldTokens.size()
+            ? static_cast<std::ptrdiff_t>(windowSpan.line + windowGeneratedLines) - static_cast<std::ptrdiff_t>(oldSpans[resync].line)
+            : std::ptrdiff_t{0};
+
+        std::string generatedCode;
+        generatedCode.reserve(Shift(m_Unit.generatedCode.size(), generatedByteDelta));
+        generatedCode.append(m_Unit.generatedCode, 0, windowSpan.offset);
+        generatedCode += windowResult.code;
+        generatedCode.append(m_Unit.generatedCode, suffixOffset);
+
+        // Splice the token stream and the emitted spans: prefix and suffix only move, the window is new.
+        std::vector<Token> tokens;
+        std::vector<EmittedSpan> spans;
+        const std::size_t suffixCount = oldTokens.size() - resync;
+        tokens.reserve(first + window.size() + suffixCount);
+        spans.reserve(tokens.capacity());
+
+        for (std::size_t index = 0; index < first; ++index)
+        {
+            auto token = oldTokens[index];
+            token.Relocate(merged.substr(token.GetStart(), token.GetContent().size()), token.GetLine(), token.GetStart());
+            tokens.push_back(token);
+            spans.push_back(oldSpans[index]);
+        }
+
+        EmittedSpan span = windowSpan;
+        for (auto token : window)
+        {
+            token.Relocate(token.GetContent(), token.GetLine() + windowLine - 1U, token.GetStart());
+            tokens.push_back(token);
+            spans.push_back(span);
+            const auto text = EmittedText(token);
+            span.offset += text.size();
+            span.line += CountNewlines(text);
+        }
+
+        for (std::size_t index = resync; index < oldTokens.size(); ++index)
+        {
+            auto token = oldTokens[index];
+            const auto start = Shift(token.GetStart(), byteDelta);
+            token.Relocate(merged.substr(start, token.GetContent().size()), Shift(token.GetLine(), lineDelta), start);
+            tokens.push_back(token);
+            spans.push_back(EmittedSpan{Shift(oldSpans[index].offset, generatedByteDelta), Shift(oldSpans[index].line, generatedLineDelta)});
+        }
+
+        auto lineOrigins = m_LineOrigins;
+        lineOrigins.SpliceLines(mergedLine, lineDelta);
+
+        // Line mappings are indexed by merged line; the window owns every line from its first token up to the line
+        // where the reused suffix starts.
+        const auto& oldMappings = m_Unit.lineMappings;
+        const std::size_t suffixLine = resync < oldTokens.size() ? oldTokens[resync].GetLine() : oldMappings.size();
+        const std::size_t windowLineCount = resync < oldTokens.size()
+            ? Shift(suffixLine, lineDelta) - windowLine
+            : (windowResult.lineMappings.empty() ? 0U : windowResult.lineMappings.size() - 1U);
+
+        std::vector<LineMapping> lineMappings(oldMappings.begin(), oldMappings.begin() + static_cast<std::ptrdiff_t>(std::min(windowLine, oldMappings.size())));
+        lineMappings.resize(windowLine + windowLineCount);
+        for (std::size_t localLine = 1; localLine <= windowLineCount && localLine < windowResult.lineMappings.size(); ++localLine)
+        {
+            auto mapping = windowResult.lineMappings[localLine];
+            if (mapping.generatedLineStart == 0)
+                continue;
+
+            const std::size_t line = windowLine + localLine - 1U;
+            mapping.generatedLineStart += windowSpan.line - 1U;
+            mapping.generatedLineEnd += windowSpan.line - 1U;
+            mapping.mergedSourceLine = line;
+            mapping.sourceLine = line;
+            if (const auto origin = lineOrigins.Find(line); origin.has_value())
+            {
+                mapping.sourceFile = origin->file;
+                mapping.sourceLine = origin->line;
+            }
+
+            lineMappings[line] = mapping;
+        }
+
+        for (std::size_t line = suffixLine; line < oldMappings.size(); ++line)
+        {
+            auto mapping = oldMappings[line];
+            if (mapping.generatedLineStart != 0)
+            {
+                mapping.generatedLineStart = Shift(mapping.generatedLineStart, generatedLineDelta);
+                mapping.generatedLineEnd = Shift(mapping.generatedLineEnd, generatedLineDelta);
+                mapping.mergedSourceLine = Shift(mapping.mergedSourceLine, lineDelta);
+                if (mapping.sourceFile == 0)
+                    mapping.sourceLine = Shift(mapping.sourceLine, lineDelta);
+            }
+
+            lineMappings.push_back(mapping);
+        }
+
+        while (!lineMappings.empty() && lineMappings.back().generatedLineStart == 0)
+            lineMappings.pop_back();
+
+        auto includeExpansions = m_IncludeExpansions;
+        const auto& rootPath = m_Unit.includedFiles.front();
+        for (auto& expansion : includeExpansions)
+        {
+            if (expansion.mergedLineStart > mergedLine)
+            {
+                expansion.mergedLineStart = Shift(expansion.mergedLineStart, lineDelta);
+                expansion.mergedLineEnd = Shift(expansion.mergedLineEnd, lineDelta);
+            }
+
+            if (expansion.sourceLine > lastRootLine && expansion.sourcePath == rootPath)
+                expansion.sourceLine = Shift(expansion.sourceLine, lineDelta);
+        }
+
+        auto generatedExpansions = Passes::ResolveIncludeExpansions(includeExpansions, lineMappings);
+
+        m_Document.text.replace(edit.offset, edit.length, edit.replacement);
+        m_Unit.tokenSource = std::move(tokenSource);
+        m_Unit.tokens = std::move(tokens);
+        m_Unit.strippedCode = std::move(strippedCode);
+        m_Unit.generatedCode = std::move(generatedCode);
+        m_Unit.lineMappings = std::move(lineMappings);
+        m_Unit.includeExpansions = std::move(generatedExpansions);
+        m_LineOrigins = std::move(lineOrigins);
+        m_IncludeExpansions = std::move(includeExpansions);
+        m_EmittedSpans = std::move(spans);
+        return true;
+    }
+}
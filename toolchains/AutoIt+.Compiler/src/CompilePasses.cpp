@@ -0,0 +1,265 @@
+#include "CompilePasses.h"
+
+#include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
+#include "AutoItPreprocessor/Compiler/Emitter.h"
+#include "AutoItPreprocessor/Compiler/OutputSink.h"
+#include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace AutoItPreprocessor::Compiler::Passes
+{
+    namespace
+    {
+        struct GeneratedSpan
+        {
+            std::size_t start = 0;
+            std::size_t end = 0;
+        };
+
+        GeneratedSpan MergeSpans(const GeneratedSpan& left, const GeneratedSpan& right) noexcept
+        {
+            if (left.start == 0)
+                return right;
+            if (right.start == 0)
+                return left;
+
+            return {std::min(left.start, right.start), std::max(left.end, right.end)};
+        }
+
+        // Bottom-up segment tree over merged source lines holding the generated span of each mapped line, so every
+        // include expansion is answered in O(log n) instead of rescanning all mappings.
+        class GeneratedSpanIndex
+        {
+        public:
+            explicit GeneratedSpanIndex(const std::vector<LineMapping>& lineMappings)
+                : m_LeafCount(lineMappings.size()),
+                  m_Nodes(2U * lineMappings.size())
+            {
+                for (const auto& mapping : lineMappings)
+                {
+                    if (mapping.generatedLineStart == 0 || mapping.generatedLineEnd == 0 || mapping.mergedSourceLine >= m_LeafCount)
+                        continue;
+
+                    auto& leaf = m_Nodes[m_LeafCount + mapping.mergedSourceLine];
+                    leaf = MergeSpans(leaf, {mapping.generatedLineStart, mapping.generatedLineEnd});
+                }
+
+                for (std::size_t node = m_LeafCount; node-- > 1U;)
+                    m_Nodes[node] = MergeSpans(m_Nodes[2U * node], m_Nodes[2U * node + 1U]);
+            }
+
+            [[nodiscard]] GeneratedSpan Query(std::size_t firstLine, std::size_t lastLine) const noexcept
+            {
+                GeneratedSpan span;
+                if (m_LeafCount == 0 || firstLine >= m_LeafCount)
+                    return span;
+
+                std::size_t low = m_LeafCount + firstLine;
+                std::size_t high = m_LeafCount + std::min(lastLine, m_LeafCount - 1U) + 1U;
+                while (low < high)
+                {
+                    if ((low & 1U) != 0)
+                        span = MergeSpans(span, m_Nodes[low++]);
+                    if ((high & 1U) != 0)
+                        span = MergeSpans(span, m_Nodes[--high]);
+
+                    low /= 2U;
+                    high /= 2U;
+                }
+
+                return span;
+            }
+
+        private:
+            std::size_t m_LeafCount = 0;
+            std::vector<GeneratedSpan> m_Nodes;
+        };
+    }
+
+    std::size_t CountNewlines(std::string_view text) noexcept
+    {
+        // memchr skips newline-free stretches far faster than a byte loop, and most tokens have none at all.
+        std::size_t count = 0;
+        const char* cursor = text.data();
+        const char* const end = cursor + text.size();
+        while (cursor != end)
+        {
+            const auto* found = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<std::size_t>(end - cursor)));
+            if (found == nullptr)
+                break;
+
+            ++count;
+            cursor = found + 1;
+        }
+
+        return count;
+    }
+
+    bool ContinuesLine(std::span<const Tokenizer::Token> tokens, std::size_t index) noexcept
+    {
+        while (index > 0)
+        {
+            const auto& previous = tokens[--index];
+            if (previous.Is(Tokenizer::TokenKind::Multiline))
+                return true;
+            if (!previous.Is(Tokenizer::TokenKind::Space) && !previous.Is(Tokenizer::TokenKind::Tab) && !previous.Is(Tokenizer::TokenKind::Comment))
+                return false;
+        }
+
+        return false;
+    }
+
+    void RewriteTokens(
+        std::string_view mergedText,
+        std::size_t mergedLineCount,
+        const CustomTokenRegistry& registry,
+        CustomBindingStore& expansions,
+        Emitter* emitter,
+        std::vector<Tokenizer::Token>* retainedTokens)
+    {
+        Tokenizer::Tokenizer tokenizer(mergedText);
+        // Replacements rarely change the size much, so the merged text is a close estimate of the output.
+        if (emitter != nullptr)
+            emitter->Reserve(mergedText.size(), emitter->MapsLines() ? mergedLineCount : 0U);
+
+        RuleRewriter rewriter(registry, expansions);
+        const auto emit = [&](const Tokenizer::Token& token)
+        {
+            if (emitter != nullptr)
+                emitter->Append(token);
+            if (retainedTokens != nullptr)
+                retainedTokens->push_back(token);
+        };
+
+        tokenizer.ForEachToken([&](Tokenizer::Token& token)
+        {
+            rewriter.Push(token, emit);
+        });
+        rewriter.Flush(emit);
+    }
+
+    std::vector<LineMapping> ResolveLineMappings(
+        std::vector<LineMapping> mergedMappings,
+        const LineOriginTable& lineOrigins)
+    {
+        for (auto& mapping : mergedMappings)
+        {
+            mapping.mergedSourceLine = mapping.sourceLine;
+            const auto origin = lineOrigins.Find(mapping.sourceLine);
+            if (!origin.has_value())
+            {
+                mapping.sourceFile = 0;
+                continue;
+            }
+
+            mapping.sourceFile = origin->file;
+            mapping.sourceLine = origin->line;
+        }
+
+        return mergedMappings;
+    }
+
+    std::vector<GeneratedIncludeExpansion> ResolveIncludeExpansions(
+        const std::vector<IncludeExpansion>& expansions,
+        const std::vector<LineMapping>& lineMappings)
+    {
+        std::vector<GeneratedIncludeExpansion> resolved;
+        resolved.reserve(expansions.size());
+
+        const GeneratedSpanIndex spanIndex(lineMappings);
+        for (const auto& expansion : expansions)
+        {
+            GeneratedIncludeExpansion generatedExpansion{
+                .sourcePath = expansion.sourcePath,
+                .sourceLine = expansion.sourceLine,
+                .includedPath = expansion.includedPath,
+                .skipped = expansion.skipped
+            };
+
+            if (!expansion.skipped)
+            {
+                const auto span = spanIndex.Query(expansion.mergedLineStart, expansion.mergedLineEnd);
+                generatedExpansion.generatedLineStart = span.start;
+                generatedExpansion.generatedLineEnd = span.end;
+
+                if (generatedExpansion.generatedLineStart == 0 || generatedExpansion.generatedLineEnd == 0)
+                    generatedExpansion.skipped = true;
+            }
+
+            resolved.push_back(std::move(generatedExpansion));
+        }
+
+        return resolved;
+    }
+
+    CompilationUnit CompileResolved(
+        IncludeResolveResult resolved,
+        const PreparedOptions& prepared,
+        CompilerOutputs outputs,
+        OutputSink* sink,
+        ResolvedOrigins* origins)
+    {
+        const bool mapsLines = HasAnyOutput(outputs, CompilerOutputs::LineMappings | CompilerOutputs::IncludeExpansions);
+        const bool emits = sink != nullptr || mapsLines || HasAnyOutput(outputs, CompilerOutputs::GeneratedCode);
+        const bool lexes = LexesFor(outputs, sink != nullptr);
+
+        if (origins != nullptr)
+        {
+            origins->lineOrigins = std::move(resolved.lineOrigins);
+            origins->includeExpansions = std::move(resolved.includeExpansions);
+        }
+        const auto& lineOrigins = origins != nullptr ? origins->lineOrigins : resolved.lineOrigins;
+        const auto& includeExpansions = origins != nullptr ? origins->includeExpansions : resolved.includeExpansions;
+
+        CompilationUnit unit;
+        unit.rootPath = resolved.mergedDocument.path;
+        unit.includedFiles = std::move(resolved.includedFiles);
+
+        if (!lexes)
+        {
+            if (HasAnyOutput(outputs, CompilerOutputs::StrippedCode))
+                unit.strippedCode = std::move(resolved.mergedDocument.text);
+            return unit;
+        }
+
+        if (HasAnyOutput(outputs, CompilerOutputs::StrippedCode))
+            unit.strippedCode = resolved.mergedDocument.text;
+        unit.tokenSource = std::make_shared<const std::string>(std::move(resolved.mergedDocument.text));
+        unit.customTokens = prepared.customTokens;
+        unit.customBindings = std::make_shared<CustomBindingStore>();
+
+        // Code nobody asked for is counted for line mappings but written nowhere.
+        NullSink discardedCode;
+        std::optional<Emitter> emitter;
+        if (emits)
+            emitter.emplace(sink != nullptr ? sink : HasAnyOutput(outputs, CompilerOutputs::GeneratedCode) ? nullptr : &discardedCode, mapsLines);
+
+        RewriteTokens(
+            *unit.tokenSource,
+            lineOrigins.GetLineCount(),
+            *unit.customTokens,
+            *unit.customBindings,
+            emitter.has_value() ? &*emitter : nullptr,
+            HasAnyOutput(outputs, CompilerOutputs::Tokens) ? &unit.tokens : nullptr);
+        if (!emitter.has_value())
+            return unit;
+
+        auto emitResult = emitter->Finish();
+        unit.generatedCode = std::move(emitResult.code);
+        if (!mapsLines)
+            return unit;
+
+        auto lineMappings = ResolveLineMappings(std::move(emitResult.lineMappings), lineOrigins);
+        if (HasAnyOutput(outputs, CompilerOutputs::IncludeExpansions))
+            unit.includeExpansions = ResolveIncludeExpansions(includeExpansions, lineMappings);
+        if (HasAnyOutput(outputs, CompilerOutputs::LineMappings))
+            unit.lineMappings = std::move(lineMappings);
+
+        return unit;
+    }
+}
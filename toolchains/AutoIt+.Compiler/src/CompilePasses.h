@@ -0,0 +1,119 @@
+#pragma once
+
+#include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
+#include "AutoItPreprocessor/Compiler/Emitter.h"
+#include "AutoItPreprocessor/Compiler/IncludeResolver.h"
+#include "AutoItPreprocessor/Compiler/LineOriginTable.h"
+#include "AutoItPreprocessor/Tokenizer/Token.h"
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace AutoItPreprocessor::Compiler::Passes
+{
+    // Stages shared by Compiler and CompilationSession.
+
+    [[nodiscard]] std::size_t CountNewlines(std::string_view text) noexcept;
+
+    // Whether a compile has to lex, and therefore needs the rules: stripped code alone does not.
+    [[nodiscard]] constexpr bool LexesFor(CompilerOutputs outputs, bool streamsCode) noexcept
+    {
+        return streamsCode || HasAnyOutput(
+            outputs,
+            CompilerOutputs::Tokens | CompilerOutputs::GeneratedCode | CompilerOutputs::LineMappings | CompilerOutputs::IncludeExpansions);
+    }
+
+    // True for a line feed that follows a `_` continuation, possibly with spaces or a comment in between.
+    [[nodiscard]] bool ContinuesLine(std::span<const Tokenizer::Token> tokens, std::size_t index) noexcept;
+
+    // Applies custom token rules to a token stream. Sequence rules never cross a logical line, so when any are
+    // loaded each line is held back until its last line feed; otherwise tokens pass straight through.
+    class RuleRewriter
+    {
+    public:
+        RuleRewriter(const CustomTokenRegistry& registry, CustomBindingStore& expansions)
+            : m_Registry(registry)
+            , m_Expansions(expansions)
+        {
+        }
+
+        template <typename Sink>
+        void Push(const Tokenizer::Token& token, Sink&& sink)
+        {
+            if (!m_Registry.HasSequences())
+            {
+                auto rewritten = token;
+                if (const auto* binding = m_Registry.Match(rewritten, m_Expansions); binding != nullptr)
+                    rewritten.RebindAsCustom(*binding);
+
+                sink(rewritten);
+                return;
+            }
+
+            m_Line.push_back(token);
+            if (token.Is(Tokenizer::TokenKind::End) || (token.Is(Tokenizer::TokenKind::LineFeed) && !ContinuesLine(m_Line, m_Line.size() - 1U)))
+                Flush(sink);
+        }
+
+        template <typename Sink>
+        void Flush(Sink&& sink)
+        {
+            const std::span<Tokenizer::Token> line(m_Line);
+            for (std::size_t position = 0; position < line.size();)
+            {
+                const auto covered = m_Registry.ApplySequence(line, position, m_Expansions);
+                if (covered == 0)
+                {
+                    if (const auto* binding = m_Registry.Match(line[position], m_Expansions); binding != nullptr)
+                        line[position].RebindAsCustom(*binding);
+                }
+
+                const auto next = position + (covered == 0 ? 1U : covered);
+                for (; position < next; ++position)
+                    sink(line[position]);
+            }
+
+            m_Line.clear();
+        }
+
+    private:
+        const CustomTokenRegistry& m_Registry;
+        CustomBindingStore& m_Expansions;
+        std::vector<Tokenizer::Token> m_Line;
+    };
+
+    // Lexes the merged text, applies the rules, and hands every token to the emitter and the retained list when given.
+    // The resolver already knows how many lines the merged text has, so the emitter is sized without rescanning it.
+    void RewriteTokens(
+        std::string_view mergedText,
+        std::size_t mergedLineCount,
+        const CustomTokenRegistry& registry,
+        CustomBindingStore& expansions,
+        Emitter* emitter,
+        std::vector<Tokenizer::Token>* retainedTokens);
+
+    [[nodiscard]] std::vector<LineMapping> ResolveLineMappings(std::vector<LineMapping> mergedMappings, const LineOriginTable& lineOrigins);
+
+    [[nodiscard]] std::vector<GeneratedIncludeExpansion> ResolveIncludeExpansions(
+        const std::vector<IncludeExpansion>& expansions,
+        const std::vector<LineMapping>& lineMappings);
+
+    // The resolver's tables behind a unit's line mappings and include expansions, kept by callers that patch the
+    // unit later instead of compiling again.
+    struct ResolvedOrigins
+    {
+        LineOriginTable lineOrigins;
+        std::vector<IncludeExpansion> includeExpansions;
+    };
+
+    // The pipeline after include resolution: lexes, rewrites and emits what `outputs` asks for, streaming the code
+    // to the sink when one is given. Moves the resolver's tables into `origins` when given.
+    [[nodiscard]] CompilationUnit CompileResolved(
+        IncludeResolveResult resolved,
+        const PreparedOptions& prepared,
+        CompilerOutputs outputs,
+        OutputSink* sink,
+        ResolvedOrigins* origins = nullptr);
+}
@@ -1,148 +1,78 @@
 #include "AutoItPreprocessor/Compiler/Compiler.h"
 
+#include "CompilePasses.h"
+
 #include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
-#include "AutoItPreprocessor/Compiler/Emitter.h"
-#include "AutoItPreprocessor/Compiler/IncludeResolver.h"
-#include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
+
+#include <system_error>
 
 namespace AutoItPreprocessor::Compiler
 {
-    namespace
+    CompilationUnit Compiler::Compile(const std::filesystem::path& inputFile, const CompilerOptions& options) const
     {
-        std::vector<LineMapping> ResolveLineMappings(
-            std::vector<LineMapping> mergedMappings,
-            const std::vector<ResolvedLineOrigin>& lineOrigins,
-            const std::filesystem::path& fallbackPath)
-        {
-            for (auto& mapping : mergedMappings)
-            {
-                if (mapping.sourceLine == 0 || mapping.sourceLine > lineOrigins.size())
-                {
-                    mapping.sourcePath = fallbackPath;
-                    mapping.mergedSourceLine = mapping.sourceLine;
-                    continue;
-                }
-
-                const auto& origin = lineOrigins[mapping.sourceLine - 1U];
-                mapping.sourcePath = origin.path.empty() ? fallbackPath : origin.path;
-                mapping.mergedSourceLine = mapping.sourceLine;
-                mapping.sourceLine = origin.line;
-            }
-
-            return mergedMappings;
-        }
-
-        std::vector<GeneratedIncludeExpansion> ResolveIncludeExpansions(
-            const std::vector<IncludeExpansion>& expansions,
-            const std::vector<LineMapping>& lineMappings)
-        {
-            std::vector<GeneratedIncludeExpansion> resolved;
-            resolved.reserve(expansions.size());
-
-            for (const auto& expansion : expansions)
-            {
-                GeneratedIncludeExpansion generatedExpansion{
-                    .sourcePath = expansion.sourcePath,
-                    .sourceLine = expansion.sourceLine,
-                    .includedPath = expansion.includedPath,
-                    .skipped = expansion.skipped
-                };
-
-                if (!expansion.skipped)
-                {
-                    for (const auto& mapping : lineMappings)
-                    {
-                        if (mapping.generatedLineStart == 0 || mapping.generatedLineEnd == 0)
-                            continue;
-                        if (mapping.mergedSourceLine < expansion.mergedLineStart || mapping.mergedSourceLine > expansion.mergedLineEnd)
-                            continue;
-
-                        if (generatedExpansion.generatedLineStart == 0 || mapping.generatedLineStart < generatedExpansion.generatedLineStart)
-                            generatedExpansion.generatedLineStart = mapping.generatedLineStart;
-                        if (mapping.generatedLineEnd > generatedExpansion.generatedLineEnd)
-                            generatedExpansion.generatedLineEnd = mapping.generatedLineEnd;
-                    }
-
-                    if (generatedExpansion.generatedLineStart == 0 || generatedExpansion.generatedLineEnd == 0)
-                        generatedExpansion.skipped = true;
-                }
-
-                resolved.push_back(std::move(generatedExpansion));
-            }
+        const auto prepared = Prepare(options, Passes::LexesFor(options.outputs, false));
+        return Passes::CompileResolved(IncludeResolver().Resolve(inputFile, prepared->searchPath), *prepared, options.outputs, nullptr);
+    }
 
-            return resolved;
-        }
+    CompilationUnit Compiler::Compile(const Common::SourceDocument& inputDocument, const CompilerOptions& options) const
+    {
+        const auto prepared = Prepare(options, Passes::LexesFor(options.outputs, false));
+        return Passes::CompileResolved(IncludeResolver().Resolve(inputDocument, prepared->searchPath), *prepared, options.outputs, nullptr);
     }
 
-    CompilationUnit Compiler::Compile(const std::filesystem::path& inputFile, const CompilerOptions& options) const
+    CompilationUnit Compiler::Compile(const std::filesystem::path& inputFile, const CompilerOptions& options, OutputSink& sink) const
     {
-        IncludeResolver includeResolver;
-        const auto resolved = includeResolver.Resolve(inputFile, options.includeDirectories);
+        const auto prepared = Prepare(options);
+        return Passes::CompileResolved(IncludeResolver().Resolve(inputFile, prepared->searchPath), *prepared, options.outputs, &sink);
+    }
 
-        Tokenizer::Tokenizer tokenizer(resolved.mergedDocument.text);
-        auto tokens = tokenizer.TokenizeAll();
+    std::shared_ptr<const PreparedOptions> Compiler::Prepare(const CompilerOptions& options, bool loadRules) const
+    {
+        // Held while loading, so threads sharing this compiler parse the rules once between them.
+        const std::lock_guard lock(m_PreparedMutex);
 
-        CustomTokenRegistry registry;
-        for (const auto& ruleFile : options.customRuleFiles)
-            registry.LoadFromFile(ruleFile);
+        const bool sameDirectories = m_Prepared != nullptr && m_PreparedIncludeDirectories == options.includeDirectories;
+        const bool sameInputs = sameDirectories && m_PreparedRuleFiles == options.customRuleFiles;
+        // A compile that never lexes takes what is prepared, with or without rules, and never touches the rule files.
+        if (!loadRules && sameInputs)
+            return m_Prepared;
 
-        for (auto& token : tokens)
+        std::vector<RuleFileStamp> ruleStamps;
+        if (loadRules)
         {
-            const auto rule = registry.Match(token);
-            if (rule.has_value())
-                token.RebindAsCustom(rule->name, rule->emit);
+            ruleStamps = StampRuleFiles(options.customRuleFiles);
+            if (sameInputs && m_Prepared->customTokens != nullptr && m_PreparedRuleStamps == ruleStamps)
+                return m_Prepared;
         }
 
-        Emitter emitter;
-        auto emitResult = emitter.Emit(tokens);
+        auto prepared = std::make_shared<PreparedOptions>();
+        prepared->searchPath = sameDirectories ? m_Prepared->searchPath : IncludeResolver::PrepareSearchPath(options.includeDirectories);
+        if (loadRules)
+            prepared->customTokens = CustomTokenRegistry::LoadFromFiles(options.customRuleFiles);
 
-        auto lineMappings = ResolveLineMappings(std::move(emitResult.lineMappings), resolved.lineOrigins, resolved.mergedDocument.path);
-        auto includeExpansions = ResolveIncludeExpansions(resolved.includeExpansions, lineMappings);
-
-        return {
-            .rootPath = resolved.mergedDocument.path,
-            .includedFiles = std::move(resolved.includedFiles),
-            .tokens = std::move(tokens),
-            .strippedCode = resolved.mergedDocument.text,
-            .generatedCode = std::move(emitResult.code),
-            .lineMappings = std::move(lineMappings),
-            .includeExpansions = std::move(includeExpansions)
-        };
+        m_PreparedIncludeDirectories = options.includeDirectories;
+        m_PreparedRuleFiles = options.customRuleFiles;
+        m_PreparedRuleStamps = std::move(ruleStamps);
+        m_Prepared = std::move(prepared);
+        return m_Prepared;
     }
 
-    CompilationUnit Compiler::Compile(const Common::SourceDocument& inputDocument, const CompilerOptions& options) const
+    std::vector<Compiler::RuleFileStamp> Compiler::StampRuleFiles(const std::vector<std::filesystem::path>& ruleFiles)
     {
-        IncludeResolver includeResolver;
-        const auto resolved = includeResolver.Resolve(inputDocument, options.includeDirectories);
-
-        Tokenizer::Tokenizer tokenizer(resolved.mergedDocument.text);
-        auto tokens = tokenizer.TokenizeAll();
-
-        CustomTokenRegistry registry;
-        for (const auto& ruleFile : options.customRuleFiles)
-            registry.LoadFromFile(ruleFile);
-
-        for (auto& token : tokens)
+        std::vector<RuleFileStamp> stamps;
+        stamps.reserve(ruleFiles.size());
+        for (const auto& ruleFile : ruleFiles)
         {
-            const auto rule = registry.Match(token);
-            if (rule.has_value())
-                token.RebindAsCustom(rule->name, rule->emit);
+            std::error_code error;
+            RuleFileStamp stamp;
+            stamp.writeTime = std::filesystem::last_write_time(ruleFile, error);
+            if (!error)
+                stamp.size = std::filesystem::file_size(ruleFile, error);
+            if (error)
+                stamp = {};
+            stamps.push_back(stamp);
         }
 
-        Emitter emitter;
-        auto emitResult = emitter.Emit(tokens);
-
-        auto lineMappings = ResolveLineMappings(std::move(emitResult.lineMappings), resolved.lineOrigins, resolved.mergedDocument.path);
-        auto includeExpansions = ResolveIncludeExpansions(resolved.includeExpansions, lineMappings);
-
-        return {
-            .rootPath = resolved.mergedDocument.path,
-            .includedFiles = std::move(resolved.includedFiles),
-            .tokens = std::move(tokens),
-            .strippedCode = resolved.mergedDocument.text,
-            .generatedCode = std::move(emitResult.code),
-            .lineMappings = std::move(lineMappings),
-            .includeExpansions = std::move(includeExpansions)
-        };
+        return stamps;
     }
 }
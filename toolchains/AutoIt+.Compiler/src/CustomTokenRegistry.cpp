@@ -1,13 +1,21 @@
 #include "AutoItPreprocessor/Compiler/CustomTokenRegistry.h"
 
+#include "CompilePasses.h"
+
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 namespace
 {
+    using AutoItPreprocessor::Compiler::PatternElement;
+    using AutoItPreprocessor::Compiler::PatternElementKind;
     using AutoItPreprocessor::Tokenizer::TokenKind;
 
     std::string Trim(std::string value)
@@ -20,10 +28,31 @@ namespace
         return value.substr(begin, end - begin + 1U);
     }
 
-    std::string Unescape(std::string value)
+    TokenKind ParseKind(const std::string& value)
+    {
+        const auto lowered = AutoItPreprocessor::Tokenizer::ToLowerCopy(value);
+        if (lowered == "word") return TokenKind::Word;
+        if (lowered == "keyword") return TokenKind::Keyword;
+        if (lowered == "string") return TokenKind::String;
+        if (lowered == "comment") return TokenKind::Comment;
+        if (lowered == "command" || lowered == "autoitcommand") return TokenKind::AutoItCommand;
+        if (lowered == "variable") return TokenKind::Variable;
+        if (lowered == "macro") return TokenKind::Macro;
+        if (lowered == "custom") return TokenKind::Custom;
+
+        for (auto kind = TokenKind::Start; kind <= TokenKind::Error; kind = static_cast<TokenKind>(static_cast<int>(kind) + 1))
+        {
+            if (lowered == AutoItPreprocessor::Tokenizer::ToLowerCopy(AutoItPreprocessor::Tokenizer::ToString(kind)))
+                return kind;
+        }
+
+        throw std::runtime_error("Unknown token kind in custom token file: " + value);
+    }
+
+    // Unescapes \\n, \\t, \\r and \\\\, and splits out \\0 to \\9 as references to captured text.
+    std::vector<AutoItPreprocessor::Compiler::EmitPart> ParseEmit(const std::string& value)
     {
-        std::string result;
-        result.reserve(value.size());
+        std::vector<AutoItPreprocessor::Compiler::EmitPart> parts(1);
 
         for (std::size_t index = 0; index < value.size(); ++index)
         {
@@ -32,45 +61,482 @@ namespace
                 const char next = value[index + 1U];
                 switch (next)
                 {
-                    case 'n': result += '\n'; ++index; continue;
-                    case 't': result += '\t'; ++index; continue;
-                    case 'r': result += '\r'; ++index; continue;
-                    case '\\': result += '\\'; ++index; continue;
+                    case 'n': parts.back().text += '\n'; ++index; continue;
+                    case 't': parts.back().text += '\t'; ++index; continue;
+                    case 'r': parts.back().text += '\r'; ++index; continue;
+                    case '\\': parts.back().text += '\\'; ++index; continue;
                     default: break;
                 }
+
+                if (next >= '0' && next <= '9')
+                {
+                    parts.push_back({.text = {}, .capture = next - '0'});
+                    parts.emplace_back();
+                    ++index;
+                    continue;
+                }
             }
 
-            result += value[index];
+            parts.back().text += value[index];
         }
 
-        return result;
+        std::erase_if(parts, [](const auto& part) { return part.capture < 0 && part.text.empty(); });
+        return parts;
     }
 
-    TokenKind ParseKind(const std::string& value)
+    bool ParseCase(const std::string& value, const std::filesystem::path& path)
     {
         const auto lowered = AutoItPreprocessor::Tokenizer::ToLowerCopy(value);
-        if (lowered == "word") return TokenKind::Word;
-        if (lowered == "keyword") return TokenKind::Keyword;
-        if (lowered == "string") return TokenKind::String;
-        if (lowered == "comment") return TokenKind::Comment;
-        if (lowered == "command" || lowered == "autoitcommand") return TokenKind::AutoItCommand;
-        if (lowered == "variable") return TokenKind::Variable;
-        if (lowered == "macro") return TokenKind::Macro;
-        if (lowered == "custom") return TokenKind::Custom;
-        throw std::runtime_error("Unknown token kind in custom token file: " + value);
+        if (lowered != "sensitive" && lowered != "insensitive")
+            throw std::runtime_error("Expected case=sensitive or case=insensitive in " + path.string());
+
+        return lowered == "insensitive";
+    }
+
+    // Items are separated by whitespace: `Kind`, `Kind:text`, `?` for any token, or `*` for a balanced run.
+    std::vector<AutoItPreprocessor::Compiler::SequenceElement> ParseSequence(const std::string& value)
+    {
+        using AutoItPreprocessor::Compiler::SequenceElement;
+        using AutoItPreprocessor::Compiler::SequenceElementKind;
+
+        std::vector<SequenceElement> elements;
+        std::stringstream stream(value);
+        std::string item;
+        while (stream >> item)
+        {
+            if (item == "*" || item == "?")
+            {
+                auto& element = elements.emplace_back();
+                element.kind = item == "*" ? SequenceElementKind::Run : SequenceElementKind::AnyToken;
+                continue;
+            }
+
+            const auto separator = item.find(':');
+            elements.push_back({
+                .kind = SequenceElementKind::Token,
+                .tokenKind = ParseKind(item.substr(0, separator)),
+                .text = separator == std::string::npos ? std::string() : item.substr(separator + 1U)
+            });
+        }
+
+        if (elements.empty() || elements.front().kind != SequenceElementKind::Token)
+            throw std::runtime_error("A token sequence must start with a token kind: " + value);
+
+        return elements;
+    }
+
+    unsigned char FoldLower(unsigned char character) noexcept
+    {
+        return character >= 'A' && character <= 'Z' ? static_cast<unsigned char>(character + ('a' - 'A')) : character;
+    }
+
+    unsigned char FoldUpper(unsigned char character) noexcept
+    {
+        return character >= 'a' && character <= 'z' ? static_cast<unsigned char>(character - ('a' - 'A')) : character;
+    }
+
+    std::vector<PatternElement> CompilePattern(const AutoItPreprocessor::Compiler::CustomTokenRule& rule)
+    {
+        std::vector<PatternElement> elements;
+        elements.reserve(rule.match.size());
+
+        for (std::size_t index = 0; index < rule.match.size(); ++index)
+        {
+            auto character = static_cast<unsigned char>(rule.match[index]);
+            if (rule.isPattern)
+            {
+                if (character == '*')
+                {
+                    // Adjacent stars would only add ambiguity, not expressiveness.
+                    if (elements.empty() || elements.back().kind != PatternElementKind::AnyRun)
+                        elements.push_back({.kind = PatternElementKind::AnyRun});
+                    continue;
+                }
+
+                if (character == '?')
+                {
+                    elements.push_back({.kind = PatternElementKind::AnyOne});
+                    continue;
+                }
+
+                if (character == '\\' && index + 1U < rule.match.size())
+                    character = static_cast<unsigned char>(rule.match[++index]);
+            }
+
+            elements.push_back({
+                .kind = PatternElementKind::Literal,
+                .lower = rule.ignoreCase ? FoldLower(character) : character,
+                .upper = rule.ignoreCase ? FoldUpper(character) : character
+            });
+        }
+
+        return elements;
     }
+
+    std::size_t CountWildcards(const std::vector<PatternElement>& elements) noexcept
+    {
+        return static_cast<std::size_t>(std::count_if(elements.begin(), elements.end(), [](const PatternElement& element)
+        {
+            return element.kind != PatternElementKind::Literal;
+        }));
+    }
+
+    // Each wildcard captures as little as the rest of the pattern allows.
+    bool MatchCaptures(
+        const std::vector<PatternElement>& elements,
+        std::size_t element,
+        std::string_view text,
+        std::size_t position,
+        std::vector<std::string_view>& captures)
+    {
+        if (element == elements.size())
+            return position == text.size();
+
+        const auto& current = elements[element];
+        if (current.kind == PatternElementKind::AnyRun)
+        {
+            for (std::size_t length = 0; position + length <= text.size(); ++length)
+            {
+                captures.push_back(text.substr(position, length));
+                if (MatchCaptures(elements, element + 1U, text, position + length, captures))
+                    return true;
+                captures.pop_back();
+            }
+
+            return false;
+        }
+
+        if (position == text.size() || !current.Accepts(static_cast<unsigned char>(text[position])))
+            return false;
+
+        if (current.kind == PatternElementKind::AnyOne)
+            captures.push_back(text.substr(position, 1));
+        if (MatchCaptures(elements, element + 1U, text, position + 1U, captures))
+            return true;
+        if (current.kind == PatternElementKind::AnyOne)
+            captures.pop_back();
+
+        return false;
+    }
+
+    std::string ExpandEmit(const std::vector<AutoItPreprocessor::Compiler::EmitPart>& parts, const std::vector<std::string_view>& captures)
+    {
+        std::string replacement;
+        for (const auto& part : parts)
+        {
+            if (part.capture < 0)
+                replacement += part.text;
+            else
+                replacement += captures[static_cast<std::size_t>(part.capture)];
+        }
+
+        return replacement;
+    }
+
+    using TokenLine = std::span<const AutoItPreprocessor::Tokenizer::Token>;
+
+    bool IsSequenceTrivia(TokenLine line, std::size_t index) noexcept
+    {
+        switch (line[index].GetKind())
+        {
+            case TokenKind::Space:
+            case TokenKind::Tab:
+            case TokenKind::Comment:
+            case TokenKind::MultiComment:
+            case TokenKind::Multiline:
+                return true;
+            case TokenKind::LineFeed:
+                return AutoItPreprocessor::Compiler::Passes::ContinuesLine(line, index);
+            default:
+                return false;
+        }
+    }
+
+    bool EndsSequenceLine(const AutoItPreprocessor::Tokenizer::Token& token) noexcept
+    {
+        return token.Is(TokenKind::LineFeed) || token.Is(TokenKind::End) || token.Is(TokenKind::Error);
+    }
+
+    bool TextEquals(std::string_view left, std::string_view right, bool ignoreCase) noexcept
+    {
+        if (!ignoreCase || left.size() != right.size())
+            return left == right;
+
+        for (std::size_t index = 0; index < left.size(); ++index)
+        {
+            if (FoldLower(static_cast<unsigned char>(left[index])) != FoldLower(static_cast<unsigned char>(right[index])))
+                return false;
+        }
+
+        return true;
+    }
+
+    std::string FoldLowerCopy(std::string_view text)
+    {
+        std::string folded(text);
+        for (auto& character : folded)
+            character = static_cast<char>(FoldLower(static_cast<unsigned char>(character)));
+
+        return folded;
+    }
+
+    using TokenSpan = std::pair<std::size_t, std::size_t>;
+
+    std::string_view SpanText(TokenLine line, TokenSpan span) noexcept
+    {
+        if (span.first == span.second)
+            return {};
+
+        const auto& first = line[span.first];
+        return {first.GetContent().data(), line[span.second - 1U].GetEnd() - first.GetStart()};
+    }
+
+    // Matches elements from `index` on, recording the tokens each one covered. Runs are tried shortest first and
+    // only end where their parentheses and brackets balance, so `Word OpenedParen * ClosedParen` finds the
+    // closing parenthesis of the call rather than the first one on the line.
+    bool MatchSequenceElements(
+        const AutoItPreprocessor::Compiler::SequenceRule& rule,
+        std::size_t element,
+        TokenLine line,
+        std::size_t index,
+        std::vector<TokenSpan>& spans,
+        std::size_t& end)
+    {
+        using AutoItPreprocessor::Compiler::SequenceElementKind;
+
+        if (element == rule.elements.size())
+        {
+            end = index;
+            return true;
+        }
+
+        std::size_t next = index;
+        while (next < line.size() && IsSequenceTrivia(line, next))
+            ++next;
+
+        const auto& current = rule.elements[element];
+        if (current.kind == SequenceElementKind::Run)
+        {
+            spans.emplace_back(index, index);
+            if (MatchSequenceElements(rule, element + 1U, line, index, spans, end))
+                return true;
+            spans.pop_back();
+
+            int depth = 0;
+            for (std::size_t position = next; position < line.size() && !EndsSequenceLine(line[position]);)
+            {
+                const auto kind = line[position].GetKind();
+                if (kind == TokenKind::OpenedParen || kind == TokenKind::OpenedSquare)
+                    ++depth;
+                else if (kind == TokenKind::ClosedParen || kind == TokenKind::ClosedSquare)
+                    --depth;
+                if (depth < 0)
+                    return false;
+
+                ++position;
+                if (depth == 0)
+                {
+                    spans.emplace_back(next, position);
+                    if (MatchSequenceElements(rule, element + 1U, line, position, spans, end))
+                        return true;
+                    spans.pop_back();
+                }
+
+                while (position < line.size() && IsSequenceTrivia(line, position))
+                    ++position;
+            }
+
+            return false;
+        }
+
+        if (next == line.size() || EndsSequenceLine(line[next]))
+            return false;
+
+        const auto& token = line[next];
+        if (current.kind == SequenceElementKind::Token
+            && (token.GetKind() != current.tokenKind || (!current.text.empty() && !TextEquals(token.GetContent(), current.text, rule.ignoreCase))))
+        {
+            return false;
+        }
+
+        spans.emplace_back(next, next + 1U);
+        if (MatchSequenceElements(rule, element + 1U, line, next + 1U, spans, end))
+            return true;
+        spans.pop_back();
+
+        return false;
+    }
+
+    struct DfaTables
+    {
+        std::array<std::uint8_t, 256> byteClasses{};
+        std::size_t classCount = 1;
+        std::uint32_t start = 0;
+        std::vector<std::uint32_t> transitions;
+        std::vector<std::uint32_t> acceptedRules;
+    };
+
+    constexpr std::size_t kMaxAutomatonStates = std::size_t{1} << 16;
+
+    // Subset construction over (rule, element) positions. Bytes that no literal tells apart share a class, which
+    // keeps the table narrow: a rule set over identifiers needs roughly one column per distinct letter.
+    DfaTables BuildDfa(
+        const std::vector<std::uint32_t>& ruleIndices,
+        const std::vector<AutoItPreprocessor::Compiler::CustomTokenRule>& rules,
+        std::uint32_t noRule)
+    {
+        DfaTables tables;
+
+        // Only distinct literal byte pairs refine the classes, so there are at most a few hundred splits.
+        std::vector<std::pair<unsigned char, unsigned char>> literals;
+        for (const auto ruleIndex : ruleIndices)
+        {
+            for (const auto& element : rules[ruleIndex].pattern)
+            {
+                if (element.kind == PatternElementKind::Literal)
+                    literals.emplace_back(element.lower, element.upper);
+            }
+        }
+        std::sort(literals.begin(), literals.end());
+        literals.erase(std::unique(literals.begin(), literals.end()), literals.end());
+
+        std::array<std::uint16_t, 256> classes{};
+        std::uint16_t classCount = 1;
+        for (const auto& [lower, upper] : literals)
+        {
+            const auto oldLowerClass = classes[lower];
+            const auto oldUpperClass = classes[upper];
+            classes[lower] = classCount;
+            classes[upper] = oldUpperClass == oldLowerClass ? classCount : static_cast<std::uint16_t>(classCount + 1U);
+            classCount = static_cast<std::uint16_t>(classCount + 2U);
+        }
+
+        std::vector<int> compacted(classCount, -1);
+        std::vector<unsigned char> representatives;
+        for (std::size_t character = 0; character < 256; ++character)
+        {
+            auto& id = compacted[classes[character]];
+            if (id < 0)
+            {
+                id = static_cast<int>(representatives.size());
+                representatives.push_back(static_cast<unsigned char>(character));
+            }
+
+            tables.byteClasses[character] = static_cast<std::uint8_t>(id);
+        }
+        tables.classCount = representatives.size();
+
+        using Position = std::uint64_t;
+        const auto makePosition = [](std::uint32_t rule, std::uint32_t element) { return (Position{rule} << 32U) | element; };
+        const auto closeOver = [&](std::vector<Position>& positions)
+        {
+            for (std::size_t index = 0; index < positions.size(); ++index)
+            {
+                const auto rule = static_cast<std::uint32_t>(positions[index] >> 32U);
+                const auto element = static_cast<std::uint32_t>(positions[index]);
+                const auto& pattern = rules[rule].pattern;
+                if (element < pattern.size() && pattern[element].kind == PatternElementKind::AnyRun)
+                    positions.push_back(makePosition(rule, element + 1U));
+            }
+
+            std::sort(positions.begin(), positions.end());
+            positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+        };
+
+        std::vector<std::vector<Position>> states;
+        std::unordered_map<std::string, std::uint32_t> stateIds;
+        const auto intern = [&](std::vector<Position> positions) -> std::uint32_t
+        {
+            std::string key(positions.size() * sizeof(Position), '\0');
+            if (!positions.empty())
+                std::memcpy(key.data(), positions.data(), key.size());
+
+            const auto [found, inserted] = stateIds.try_emplace(std::move(key), static_cast<std::uint32_t>(states.size()));
+            if (inserted)
+            {
+                if (states.size() >= kMaxAutomatonStates)
+                    throw std::runtime_error("Custom token patterns are too complex to compile into one automaton.");
+
+                states.push_back(std::move(positions));
+            }
+
+            return found->second;
+        };
+
+        intern({});
+        std::vector<Position> initial;
+        for (const auto ruleIndex : ruleIndices)
+            initial.push_back(makePosition(ruleIndex, 0));
+        closeOver(initial);
+        tables.start = intern(std::move(initial));
+
+        for (std::size_t state = 0; state < states.size(); ++state)
+        {
+            auto accepted = noRule;
+            for (const auto position : states[state])
+            {
+                const auto rule = static_cast<std::uint32_t>(position >> 32U);
+                if (static_cast<std::uint32_t>(position) == rules[rule].pattern.size())
+                    accepted = std::min(accepted, rule);
+            }
+            tables.acceptedRules.push_back(accepted);
+
+            for (std::size_t byteClass = 0; byteClass < tables.classCount; ++byteClass)
+            {
+                const auto character = representatives[byteClass];
+                std::vector<Position> next;
+                for (const auto position : states[state])
+                {
+                    const auto rule = static_cast<std::uint32_t>(position >> 32U);
+                    const auto element = static_cast<std::uint32_t>(position);
+                    const auto& pattern = rules[rule].pattern;
+                    if (element == pattern.size() || !pattern[element].Accepts(character))
+                        continue;
+
+                    next.push_back(pattern[element].kind == PatternElementKind::AnyRun ? position : makePosition(rule, element + 1U));
+                }
+
+                closeOver(next);
+                const auto target = intern(std::move(next));
+                tables.transitions.push_back(target);
+            }
+        }
+
+        return tables;
+    }
+
 }
 
 namespace AutoItPreprocessor::Compiler
 {
+    std::shared_ptr<const CustomTokenRegistry> CustomTokenRegistry::LoadFromFiles(const std::vector<std::filesystem::path>& paths)
+    {
+        auto registry = std::make_shared<CustomTokenRegistry>();
+        for (const auto& path : paths)
+            registry->ParseFile(path);
+
+        registry->BuildAutomata();
+        return registry;
+    }
+
     void CustomTokenRegistry::LoadFromFile(const std::filesystem::path& path)
+    {
+        ParseFile(path);
+        BuildAutomata();
+    }
+
+    void CustomTokenRegistry::ParseFile(const std::filesystem::path& path)
     {
         std::ifstream input(path);
         if (!input.is_open())
             throw std::runtime_error("Could not open custom token file: " + path.string());
 
         CustomTokenRule currentRule;
+        SequenceRule currentSequence;
         bool inRule = false;
+        bool inSequence = false;
+        bool hasMatch = false;
+        bool hasPattern = false;
         std::string line;
 
         while (std::getline(input, line))
@@ -79,32 +545,94 @@ namespace AutoItPreprocessor::Compiler
             if (trimmed.empty() || trimmed.starts_with('#'))
                 continue;
 
+            if (trimmed.starts_with("sequence "))
+            {
+                if (inRule || inSequence)
+                    throw std::runtime_error("Nested token blocks are not allowed in " + path.string());
+
+                inSequence = true;
+                currentSequence = {};
+                currentSequence.binding.name = Trim(trimmed.substr(9));
+                currentSequence.consumed.name = currentSequence.binding.name;
+                continue;
+            }
+
             if (trimmed.starts_with("token "))
             {
-                if (inRule)
+                if (inRule || inSequence)
                     throw std::runtime_error("Nested token blocks are not allowed in " + path.string());
 
                 inRule = true;
+                hasMatch = false;
+                hasPattern = false;
                 currentRule = {};
-                currentRule.name = Trim(trimmed.substr(6));
+                currentRule.binding.name = Trim(trimmed.substr(6));
+                continue;
+            }
+
+            if (trimmed == "end" && inSequence)
+            {
+                if (currentSequence.binding.name.empty() || currentSequence.elements.empty())
+                    throw std::runtime_error("Invalid token sequence in " + path.string());
+
+                for (const auto& part : currentSequence.emit)
+                {
+                    if (part.capture > static_cast<int>(currentSequence.elements.size()))
+                        throw std::runtime_error("Emit of sequence " + currentSequence.binding.name + " references a missing capture in " + path.string());
+
+                    currentSequence.capturesText = currentSequence.capturesText || part.capture >= 0;
+                }
+
+                if (!currentSequence.capturesText)
+                    currentSequence.binding.replacement = ExpandEmit(currentSequence.emit, {});
+
+                m_Sequences.push_back(std::move(currentSequence));
+                inSequence = false;
+                currentSequence = {};
                 continue;
             }
 
             if (trimmed == "end")
             {
-                if (!inRule || currentRule.name.empty() || currentRule.match.empty())
+                if (!inRule || currentRule.binding.name.empty() || currentRule.match.empty() || (hasMatch && hasPattern))
                     throw std::runtime_error("Invalid token rule in " + path.string());
 
                 if (currentRule.allowedKinds.empty())
                     currentRule.allowedKinds.push_back(TokenKind::Word);
 
-                m_Rules.push_back(currentRule);
+                // An exact, case-sensitive match has nothing to capture, so `\0` to `\9` stay the literal text they were
+                // before captures existed.
+                if (!currentRule.isPattern && !currentRule.ignoreCase)
+                {
+                    for (auto& part : currentRule.emit)
+                    {
+                        if (part.capture >= 0)
+                            part = {.text = {'\\', static_cast<char>('0' + part.capture)}, .capture = -1};
+                    }
+                }
+
+                currentRule.pattern = CompilePattern(currentRule);
+                const auto wildcards = CountWildcards(currentRule.pattern);
+                for (const auto& part : currentRule.emit)
+                {
+                    if (part.capture > static_cast<int>(wildcards))
+                        throw std::runtime_error("Emit of token " + currentRule.binding.name + " references a missing capture in " + path.string());
+
+                    if (part.capture > 0 || (part.capture == 0 && (currentRule.isPattern || currentRule.ignoreCase)))
+                        currentRule.capturesText = true;
+                }
+
+                // Without captures that vary per token, the replacement is fixed once here.
+                if (!currentRule.capturesText)
+                    currentRule.binding.replacement = ExpandEmit(currentRule.emit, {currentRule.match});
+
+                m_Rules.push_back(std::move(currentRule));
                 inRule = false;
                 currentRule = {};
                 continue;
             }
 
-            if (!inRule)
+            if (!inRule && !inSequence)
                 throw std::runtime_error("Properties must be inside a token block in " + path.string());
 
             const auto separator = trimmed.find('=');
@@ -114,10 +642,30 @@ namespace AutoItPreprocessor::Compiler
             const auto key = Trim(trimmed.substr(0, separator));
             const auto value = Trim(trimmed.substr(separator + 1U));
 
-            if (key == "match")
+            if (inSequence)
+            {
+                if (key == "match")
+                    currentSequence.elements = ParseSequence(value);
+                else if (key == "emit")
+                    currentSequence.emit = ParseEmit(value);
+                else if (key == "case")
+                    currentSequence.ignoreCase = ParseCase(value, path);
+                else
+                    throw std::runtime_error("Unknown custom sequence property: " + key);
+
+                continue;
+            }
+
+            if (key == "match" || key == "pattern")
+            {
                 currentRule.match = value;
+                currentRule.isPattern = key == "pattern";
+                (currentRule.isPattern ? hasPattern : hasMatch) = true;
+            }
+            else if (key == "case")
+                currentRule.ignoreCase = ParseCase(value, path);
             else if (key == "emit")
-                currentRule.emit = Unescape(value);
+                currentRule.emit = ParseEmit(value);
             else if (key == "kinds")
             {
                 currentRule.allowedKinds.clear();
@@ -130,24 +678,160 @@ namespace AutoItPreprocessor::Compiler
                 throw std::runtime_error("Unknown custom token property: " + key);
         }
 
-        if (inRule)
+        if (inRule || inSequence)
             throw std::runtime_error("Unterminated token block in " + path.string());
     }
 
-    std::optional<CustomTokenRule> CustomTokenRegistry::Match(const Tokenizer::Token& token) const
+    void CustomTokenRegistry::BuildAutomata()
+    {
+        std::array<std::vector<std::uint32_t>, kKindCount> rulesByKind;
+        for (std::uint32_t index = 0; index < m_Rules.size(); ++index)
+        {
+            for (const auto allowedKind : m_Rules[index].allowedKinds)
+            {
+                auto& rules = rulesByKind[static_cast<std::size_t>(allowedKind)];
+                if (rules.empty() || rules.back() != index)
+                    rules.push_back(index);
+            }
+        }
+
+        m_TargetedKinds = 0;
+        for (std::size_t kind = 0; kind < kKindCount; ++kind)
+        {
+            auto& automaton = m_Automata[kind];
+            if (rulesByKind[kind].empty())
+            {
+                automaton = {};
+                continue;
+            }
+
+            auto tables = BuildDfa(rulesByKind[kind], m_Rules, kNoRule);
+            automaton.byteClasses = tables.byteClasses;
+            automaton.classCount = tables.classCount;
+            automaton.start = tables.start;
+            automaton.transitions = std::move(tables.transitions);
+            automaton.acceptedRules = std::move(tables.acceptedRules);
+            m_TargetedKinds |= std::uint64_t{1} << kind;
+        }
+
+        m_SequenceHeads = {};
+        for (std::uint32_t index = 0; index < m_Sequences.size(); ++index)
+        {
+            const auto& head = m_Sequences[index].elements.front();
+            auto& heads = m_SequenceHeads[static_cast<std::size_t>(head.tokenKind)];
+            if (head.text.empty())
+                heads.anyText.push_back(index);
+            else
+                heads.byText[FoldLowerCopy(head.text)].push_back(index);
+        }
+    }
+
+    const Tokenizer::CustomBinding* CustomTokenRegistry::Match(const Tokenizer::Token& token, CustomBindingStore& expansions) const
     {
-        for (const auto& rule : m_Rules)
+        const auto kind = static_cast<std::size_t>(token.GetKind());
+        if ((m_TargetedKinds & (std::uint64_t{1} << kind)) == 0)
+            return nullptr;
+
+        const auto& automaton = m_Automata[kind];
+        const auto content = token.GetContent();
+        std::uint32_t state = automaton.start;
+        for (const char character : content)
         {
-            if (rule.match != token.GetContent())
+            state = automaton.transitions[state * automaton.classCount + automaton.byteClasses[static_cast<unsigned char>(character)]];
+            if (state == 0)
+                return nullptr;
+        }
+
+        const auto ruleIndex = automaton.acceptedRules[state];
+        if (ruleIndex == kNoRule)
+            return nullptr;
+
+        const auto& rule = m_Rules[ruleIndex];
+        return rule.capturesText ? &Expand(ruleIndex, content, expansions) : &rule.binding;
+    }
+
+    const Tokenizer::CustomBinding& CustomTokenRegistry::Expand(std::uint32_t ruleIndex, std::string_view text, CustomBindingStore& expansions) const
+    {
+        std::string key(1U + sizeof(ruleIndex), 'T');
+        std::memcpy(key.data() + 1, &ruleIndex, sizeof(ruleIndex));
+        key += text;
+
+        if (const auto found = expansions.m_Bindings.find(key); found != expansions.m_Bindings.end())
+            return *found->second;
+
+        const auto& rule = m_Rules[ruleIndex];
+        std::vector<std::string_view> captures{text};
+        MatchCaptures(rule.pattern, 0, text, 0, captures);
+
+        auto binding = std::make_unique<Tokenizer::CustomBinding>();
+        binding->name = rule.binding.name;
+        binding->replacement = ExpandEmit(rule.emit, captures);
+        return *expansions.m_Bindings.emplace(std::move(key), std::move(binding)).first->second;
+    }
+
+    std::size_t CustomTokenRegistry::ApplySequence(std::span<Tokenizer::Token> line, std::size_t position, CustomBindingStore& expansions) const
+    {
+        const auto& first = line[position];
+        const auto& heads = m_SequenceHeads[static_cast<std::size_t>(first.GetKind())];
+        if (heads.anyText.empty() && heads.byText.empty())
+            return 0;
+
+        static const std::vector<std::uint32_t> kNone;
+        const auto byText = heads.byText.empty() ? heads.byText.end() : heads.byText.find(FoldLowerCopy(first.GetContent()));
+        const auto& textCandidates = byText == heads.byText.end() ? kNone : byText->second;
+
+        // Both candidate lists are in load order; merging them keeps first-loaded-wins.
+        std::vector<TokenSpan> spans;
+        auto textCandidate = textCandidates.begin();
+        auto kindCandidate = heads.anyText.begin();
+        while (textCandidate != textCandidates.end() || kindCandidate != heads.anyText.end())
+        {
+            const bool takeText = kindCandidate == heads.anyText.end() || (textCandidate != textCandidates.end() && *textCandidate < *kindCandidate);
+            const auto index = takeText ? *textCandidate++ : *kindCandidate++;
+            const auto& rule = m_Sequences[index];
+
+            spans.clear();
+            std::size_t end = 0;
+            if (!MatchSequenceElements(rule, 0, line, position, spans, end))
                 continue;
 
-            for (const auto allowedKind : rule.allowedKinds)
+            const auto* binding = &rule.binding;
+            if (rule.capturesText)
             {
-                if (token.GetKind() == allowedKind)
-                    return rule;
+                std::vector<std::string_view> captures{SpanText(line, {position, end})};
+                for (const auto& span : spans)
+                    captures.push_back(SpanText(line, span));
+
+                binding = &ExpandSequence(index, captures, expansions);
             }
+
+            line[position].RebindAsCustom(*binding);
+            for (auto covered = position + 1U; covered < end; ++covered)
+                line[covered].RebindAsCustom(rule.consumed);
+
+            return end - position;
         }
 
-        return std::nullopt;
+        return 0;
+    }
+
+    const Tokenizer::CustomBinding& CustomTokenRegistry::ExpandSequence(
+        std::uint32_t sequenceIndex,
+        const std::vector<std::string_view>& captures,
+        CustomBindingStore& expansions) const
+    {
+        // The covered source text decides every capture, so it is the whole key.
+        std::string key(1U + sizeof(sequenceIndex), 'S');
+        std::memcpy(key.data() + 1, &sequenceIndex, sizeof(sequenceIndex));
+        key += captures.front();
+
+        if (const auto found = expansions.m_Bindings.find(key); found != expansions.m_Bindings.end())
+            return *found->second;
+
+        const auto& rule = m_Sequences[sequenceIndex];
+        auto binding = std::make_unique<Tokenizer::CustomBinding>();
+        binding->name = rule.binding.name;
+        binding->replacement = ExpandEmit(rule.emit, captures);
+        return *expansions.m_Bindings.emplace(std::move(key), std::move(binding)).first->second;
     }
 }
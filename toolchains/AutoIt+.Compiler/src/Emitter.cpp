@@ -1,27 +1,21 @@
 #include "AutoItPreprocessor/Compiler/Emitter.h"
 
+#include "CompilePasses.h"
+
 #include <algorithm>
+#include <string_view>
+#include <utility>
 
 namespace AutoItPreprocessor::Compiler
 {
     namespace
     {
-        std::size_t CountTouchedLines(const std::string& text)
+        std::string_view EmittedText(const Tokenizer::Token& token) noexcept
         {
-            if (text.empty())
-                return 0;
-
-            std::size_t touchedLines = 1;
-            for (char character : text)
-            {
-                if (character == '\n')
-                    ++touchedLines;
-            }
-
-            if (text.back() == '\n')
-                --touchedLines;
+            if (token.Is(Tokenizer::TokenKind::End))
+                return {};
 
-            return std::max<std::size_t>(1, touchedLines);
+            return token.Is(Tokenizer::TokenKind::Custom) ? token.GetReplacement() : token.GetContent();
         }
 
         void UpdateLineMapping(std::vector<LineMapping>& mappings, std::size_t sourceLine, std::size_t generatedLineStart, std::size_t generatedLineEnd)
@@ -36,6 +30,7 @@ namespace AutoItPreprocessor::Compiler
             if (mapping.sourceLine == 0)
             {
                 mapping.sourceLine = sourceLine;
+                mapping.mergedSourceLine = sourceLine;
                 mapping.generatedLineStart = generatedLineStart;
                 mapping.generatedLineEnd = generatedLineEnd;
                 return;
@@ -46,38 +41,66 @@ namespace AutoItPreprocessor::Compiler
         }
     }
 
-    EmitResult Emitter::Emit(const std::vector<Tokenizer::Token>& tokens) const
+    EmitResult Emitter::Emit(const std::vector<Tokenizer::Token>& tokens)
     {
-        EmitResult result;
-        std::size_t generatedLine = 1;
-
+        std::size_t codeSize = 0;
+        std::size_t lineCount = 0;
         for (const auto& token : tokens)
         {
-            if (token.Is(Tokenizer::TokenKind::End))
-                continue;
+            codeSize += EmittedText(token).size();
+            lineCount = std::max(lineCount, token.GetLine());
+        }
 
-            const std::string& emittedText = token.Is(Tokenizer::TokenKind::Custom) ? token.GetReplacement() : token.GetContent();
-            if (!emittedText.empty())
-            {
-                const std::size_t generatedLineStart = generatedLine;
-                const std::size_t generatedLineEnd = generatedLineStart + CountTouchedLines(emittedText) - 1U;
-                UpdateLineMapping(result.lineMappings, token.GetLine(), generatedLineStart, generatedLineEnd);
-                if (token.GetLine() < result.lineMappings.size())
-                    result.lineMappings[token.GetLine()].mergedSourceLine = token.GetLine();
-
-                for (char character : emittedText)
-                {
-                    if (character == '\n')
-                        ++generatedLine;
-                }
-            }
+        Reserve(codeSize, lineCount);
+        for (const auto& token : tokens)
+            Append(token);
 
-            if (token.Is(Tokenizer::TokenKind::Custom))
-                result.code += token.GetReplacement();
+        return Finish();
+    }
+
+    void Emitter::Reserve(std::size_t codeSize, std::size_t lineCount)
+    {
+        if (m_Sink == nullptr)
+            m_Result.code.reserve(codeSize);
+        if (m_MapLines && m_Result.lineMappings.size() <= lineCount)
+            m_Result.lineMappings.resize(lineCount + 1U);
+    }
+
+    void Emitter::Append(const Tokenizer::Token& token)
+    {
+        const std::string_view emittedText = EmittedText(token);
+        if (emittedText.empty())
+            return;
+
+        if (!m_MapLines)
+        {
+            if (m_Sink != nullptr)
+                m_Sink->Write(emittedText);
             else
-                result.code += token.GetContent();
+                m_Result.code += emittedText;
+            return;
         }
 
-        return result;
+        // A trailing newline ends the last line the text touches rather than starting another one.
+        const std::size_t newlines = Passes::CountNewlines(emittedText);
+        const std::size_t touchedLines = std::max<std::size_t>(1, newlines + 1U - (emittedText.back() == '\n' ? 1U : 0U));
+        UpdateLineMapping(m_Result.lineMappings, token.GetLine(), m_GeneratedLine, m_GeneratedLine + touchedLines - 1U);
+
+        m_GeneratedLine += newlines;
+        if (m_Sink != nullptr)
+            m_Sink->Write(emittedText);
+        else
+            m_Result.code += emittedText;
+    }
+
+    EmitResult Emitter::Finish()
+    {
+        // Reserved entries past the last line that emitted anything are not part of the result.
+        auto& mappings = m_Result.lineMappings;
+        while (!mappings.empty() && mappings.back().sourceLine == 0)
+            mappings.pop_back();
+
+        m_GeneratedLine = 1;
+        return std::exchange(m_Result, {});
     }
 }
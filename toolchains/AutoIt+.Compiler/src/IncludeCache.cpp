@@ -0,0 +1,164 @@
+#include "AutoItPreprocessor/Compiler/IncludeCache.h"
+
+#include "AutoItPreprocessor/Common/SourceFile.h"
+#include "AutoItPreprocessor/Compiler/IncludeDirective.h"
+
+namespace AutoItPreprocessor::Compiler
+{
+    SourceOutline SourceOutline::Parse(std::string_view text)
+    {
+        SourceOutline outline;
+        std::size_t fileLine = 0;
+        std::size_t position = 0;
+
+        while (position < text.size())
+        {
+            const auto lineStart = position;
+            const auto lineEnd = text.find('\n', position);
+            position = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1U;
+            ++fileLine;
+
+            const auto directive = ScanIncludeDirective(text.substr(lineStart, position - lineStart));
+            if (directive.kind == IncludeDirectiveKind::IncludeOnce)
+            {
+                outline.includeOnce = true;
+                continue;
+            }
+
+            if (directive.IsInclude())
+            {
+                outline.segments.push_back(SourceSegment{
+                    .kind = SourceSegmentKind::Include,
+                    .offset = static_cast<std::size_t>(directive.text.data() - text.data()),
+                    .length = directive.text.size(),
+                    .firstLine = fileLine,
+                    .lineCount = 1
+                });
+                continue;
+            }
+
+            auto* previous = outline.segments.empty() ? nullptr : &outline.segments.back();
+            if (previous != nullptr
+                && previous->kind == SourceSegmentKind::Code
+                && previous->offset + previous->length == lineStart)
+            {
+                previous->length += position - lineStart;
+                ++previous->lineCount;
+                continue;
+            }
+
+            outline.segments.push_back(SourceSegment{
+                .kind = SourceSegmentKind::Code,
+                .offset = lineStart,
+                .length = position - lineStart,
+                .firstLine = fileLine,
+                .lineCount = 1
+            });
+        }
+
+        return outline;
+    }
+
+    IncludeCache& IncludeCache::Shared()
+    {
+        static IncludeCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<const CachedSource> IncludeCache::Load(const std::filesystem::path& canonicalPath)
+    {
+        std::error_code error;
+        const auto writeTime = std::filesystem::last_write_time(canonicalPath, error);
+        const auto size = error ? std::uintmax_t{0} : std::filesystem::file_size(canonicalPath, error);
+        const bool stamped = !error;
+
+        if (stamped)
+        {
+            const std::lock_guard lock(m_Mutex);
+            if (const auto found = m_Entries.find(canonicalPath);
+                found != m_Entries.end() && found->second.writeTime == writeTime && found->second.size == size)
+            {
+                return found->second.source;
+            }
+        }
+
+        const Common::SourceFile sourceFile(canonicalPath);
+        auto source = std::make_shared<CachedSource>();
+        source->text = std::string(sourceFile.GetText());
+        source->outline = SourceOutline::Parse(source->text);
+
+        if (stamped)
+        {
+            const std::lock_guard lock(m_Mutex);
+            m_Entries.insert_or_assign(canonicalPath, Entry{
+                .writeTime = writeTime,
+                .size = size,
+                .source = source
+            });
+        }
+
+        return source;
+    }
+
+    void IncludeCache::Clear()
+    {
+        const std::lock_guard lock(m_Mutex);
+        m_Entries.clear();
+    }
+
+    std::filesystem::file_time_type DirectoryStamps::Get(const std::filesystem::path& directory)
+    {
+        {
+            const std::lock_guard lock(m_Mutex);
+            if (const auto found = m_Stamps.find(directory); found != m_Stamps.end())
+                return found->second;
+        }
+
+        std::error_code error;
+        auto stamp = std::filesystem::last_write_time(directory, error);
+        if (error)
+            stamp = std::filesystem::file_time_type::min();
+
+        const std::lock_guard lock(m_Mutex);
+        return m_Stamps.try_emplace(directory, stamp).first->second;
+    }
+
+    IncludePathCache& IncludePathCache::Shared()
+    {
+        static IncludePathCache cache;
+        return cache;
+    }
+
+    std::optional<IncludePathResolution> IncludePathCache::Find(const Key& key, DirectoryStamps& stamps)
+    {
+        std::optional<IncludePathResolution> resolution;
+        {
+            const std::lock_guard lock(m_Mutex);
+            const auto found = m_Entries.find(key);
+            if (found == m_Entries.end())
+                return std::nullopt;
+
+            resolution = found->second;
+        }
+
+        for (const auto& [directory, stamp] : resolution->probedDirectories)
+        {
+            if (stamps.Get(directory) != stamp)
+                return std::nullopt;
+        }
+
+        return resolution;
+    }
+
+    void IncludePathCache::Store(Key key, IncludePathResolution resolution)
+    {
+        const std::lock_guard lock(m_Mutex);
+        m_Entries.insert_or_assign(std::move(key), std::move(resolution));
+    }
+
+    void IncludePathCache::Clear()
+    {
+        const std::lock_guard lock(m_Mutex);
+        m_Entries.clear();
+    }
+}
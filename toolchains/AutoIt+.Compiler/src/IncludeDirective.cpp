@@ -0,0 +1,83 @@
+#include "AutoItPreprocessor/Compiler/IncludeDirective.h"
+
+namespace
+{
+    constexpr std::string_view kIncludeOnce = "#include-once";
+    constexpr std::string_view kInclude = "#include ";
+
+    bool IsDirectiveSpace(char character) noexcept
+    {
+        return character == ' ' || character == '\t' || character == '\r' || character == '\n' || character == '\v' || character == '\f';
+    }
+
+    // AutoIt directives ignore letter case, so `#Include` and `#INCLUDE-ONCE` count as well.
+    bool StartsWithIgnoreCase(std::string_view text, std::string_view prefix) noexcept
+    {
+        if (text.size() < prefix.size())
+            return false;
+
+        for (std::size_t index = 0; index < prefix.size(); ++index)
+        {
+            const char character = text[index];
+            const char lowered = character >= 'A' && character <= 'Z' ? static_cast<char>(character + ('a' - 'A')) : character;
+            if (lowered != prefix[index])
+                return false;
+        }
+
+        return true;
+    }
+
+    std::string_view Trim(std::string_view value) noexcept
+    {
+        const auto begin = value.find_first_not_of(" \t\r\n");
+        if (begin == std::string_view::npos)
+            return {};
+
+        const auto end = value.find_last_not_of(" \t\r\n");
+        return value.substr(begin, end - begin + 1U);
+    }
+}
+
+namespace AutoItPreprocessor::Compiler
+{
+    IncludeDirective ScanIncludeDirective(std::string_view line) noexcept
+    {
+        IncludeDirective directive;
+        directive.text = Trim(line);
+
+        const auto text = directive.text;
+        if (text.size() < kInclude.size() || text[0] != '#')
+            return directive;
+
+        if (text.size() == kIncludeOnce.size() && StartsWithIgnoreCase(text, kIncludeOnce))
+        {
+            directive.kind = IncludeDirectiveKind::IncludeOnce;
+            return directive;
+        }
+
+        if (!StartsWithIgnoreCase(text, kInclude))
+            return directive;
+
+        directive.kind = IncludeDirectiveKind::Include;
+
+        std::size_t cursor = kInclude.size();
+        while (cursor < text.size() && IsDirectiveSpace(text[cursor]))
+            ++cursor;
+
+        if (cursor >= text.size())
+            return directive;
+
+        const char open = text[cursor];
+        const char close = open == '<' ? '>' : open == '"' ? '"' : '\0';
+        if (close == '\0')
+            return directive;
+
+        const auto end = text.find(close, cursor + 1U);
+        if (end == std::string_view::npos || end == cursor + 1U)
+            return directive;
+
+        directive.name = text.substr(cursor + 1U, end - cursor - 1U);
+        directive.global = open == '<';
+        return directive;
+    }
+}
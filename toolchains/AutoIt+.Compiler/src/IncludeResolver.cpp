@@ -1,10 +1,17 @@
 #include "AutoItPreprocessor/Compiler/IncludeResolver.h"
 
-#include <fstream>
-#include <regex>
-#include <sstream>
+#include "AutoItPreprocessor/Common/ThreadPool.h"
+#include "AutoItPreprocessor/Compiler/IncludeDirective.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -13,43 +20,6 @@
 
 namespace
 {
-    std::string StripUtf8Bom(std::string text)
-    {
-        if (text.size() >= 3U
-            && static_cast<unsigned char>(text[0]) == 0xEF
-            && static_cast<unsigned char>(text[1]) == 0xBB
-            && static_cast<unsigned char>(text[2]) == 0xBF)
-        {
-            text.erase(0, 3);
-        }
-
-        return text;
-    }
-
-    std::string ReadFile(const std::filesystem::path& path)
-    {
-        std::ifstream input(path, std::ios::binary);
-        if (!input.is_open())
-            throw std::runtime_error("Could not open source file: " + path.string());
-
-        return StripUtf8Bom(std::string((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>()));
-    }
-
-    std::string Trim(std::string value)
-    {
-        const auto begin = value.find_first_not_of(" \t\r\n");
-        if (begin == std::string::npos)
-            return "";
-
-        const auto end = value.find_last_not_of(" \t\r\n");
-        return value.substr(begin, end - begin + 1U);
-    }
-
-    bool StartsWithInclude(const std::string& line)
-    {
-        return line.starts_with("#include ");
-    }
-
     std::vector<std::filesystem::path> LoadAutoItRegistryIncludeDirectories()
     {
         std::vector<std::filesystem::path> includeDirectories;
@@ -157,79 +127,103 @@ namespace
         return std::nullopt;
     }
 
+    void AppendIfMissing(
+        std::vector<std::filesystem::path>& directories,
+        std::vector<std::filesystem::path>& normalizedDirectories,
+        const std::filesystem::path& directory)
+    {
+        auto normalized = directory.lexically_normal();
+        if (std::find(normalizedDirectories.begin(), normalizedDirectories.end(), normalized) != normalizedDirectories.end())
+            return;
+
+        directories.push_back(directory);
+        normalizedDirectories.push_back(std::move(normalized));
+    }
+
     std::vector<std::filesystem::path> MergeIncludeDirectories(const std::vector<std::filesystem::path>& includeDirectories)
     {
+        static const auto registryDirectories = LoadAutoItRegistryIncludeDirectories();
+        static const auto installIncludeDirectory = LoadAutoItInstallIncludeDirectory();
+
         std::vector<std::filesystem::path> mergedDirectories = includeDirectories;
+        std::vector<std::filesystem::path> normalizedDirectories;
+        normalizedDirectories.reserve(includeDirectories.size() + registryDirectories.size() + 1U);
+        for (const auto& includeDirectory : includeDirectories)
+            normalizedDirectories.push_back(includeDirectory.lexically_normal());
 
-        for (const auto& registryDirectory : LoadAutoItRegistryIncludeDirectories())
-        {
-            const auto canonicalCandidate = std::filesystem::path(registryDirectory).lexically_normal();
-            const auto alreadyPresent = std::find_if(
-                mergedDirectories.begin(),
-                mergedDirectories.end(),
-                [&](const std::filesystem::path& existing)
-                {
-                    return existing.lexically_normal() == canonicalCandidate;
-                });
+        for (const auto& registryDirectory : registryDirectories)
+            AppendIfMissing(mergedDirectories, normalizedDirectories, registryDirectory);
 
-            if (alreadyPresent == mergedDirectories.end())
-                mergedDirectories.push_back(registryDirectory);
-        }
+        if (installIncludeDirectory.has_value())
+            AppendIfMissing(mergedDirectories, normalizedDirectories, *installIncludeDirectory);
 
-        if (const auto installIncludeDirectory = LoadAutoItInstallIncludeDirectory(); installIncludeDirectory.has_value())
-        {
-            const auto canonicalCandidate = installIncludeDirectory->lexically_normal();
-            const auto alreadyPresent = std::find_if(
-                mergedDirectories.begin(),
-                mergedDirectories.end(),
-                [&](const std::filesystem::path& existing)
-                {
-                    return existing.lexically_normal() == canonicalCandidate;
-                });
+        return mergedDirectories;
+    }
 
-            if (alreadyPresent == mergedDirectories.end())
-                mergedDirectories.push_back(*installIncludeDirectory);
+    AutoItPreprocessor::Compiler::IncludePathCache::Key MakeDirectoryListKey(const std::vector<std::filesystem::path>& includeDirectories)
+    {
+        AutoItPreprocessor::Compiler::IncludePathCache::Key key;
+        for (const auto& includeDirectory : includeDirectories)
+        {
+            key += includeDirectory.native();
+            key += '\0';
         }
 
-        return mergedDirectories;
+        return key;
     }
 
     std::filesystem::path ResolveIncludePath(
-        const std::string& line,
+        std::string_view line,
         const std::filesystem::path& currentFile,
-        const std::vector<std::filesystem::path>& includeDirectories)
+        const std::vector<std::filesystem::path>& includeDirectories,
+        const AutoItPreprocessor::Compiler::IncludePathCache::Key& directoryListKey,
+        AutoItPreprocessor::Compiler::DirectoryStamps& stamps)
     {
-        static const std::regex includeRegex(R"(^\s*#include\s+((<[^>]+>)|(\"[^\"]+\")))");
-        std::smatch match;
-        std::string payload;
-        if (std::regex_search(line, match, includeRegex))
-            payload = match[1].str();
+        using AutoItPreprocessor::Compiler::IncludePathCache;
 
-        const bool localInclude = payload.size() >= 2U && payload.front() == '"' && payload.back() == '"';
-        const bool globalInclude = payload.size() >= 2U && payload.front() == '<' && payload.back() == '>';
+        const auto directive = AutoItPreprocessor::Compiler::ScanIncludeDirective(line);
+        if (!directive.IsWellFormed())
+            throw std::runtime_error("Invalid #include directive in " + currentFile.string() + ": " + std::string(line));
 
-        if (!localInclude && !globalInclude)
-            throw std::runtime_error("Invalid #include directive in " + currentFile.string() + ": " + line);
+        const bool localInclude = !directive.global;
+        const std::filesystem::path includeName = directive.name;
 
-        const std::filesystem::path includeName = payload.substr(1, payload.size() - 2U);
         std::vector<std::filesystem::path> searchedPaths;
-
+        searchedPaths.reserve(includeDirectories.size() + 1U);
         if (localInclude)
-        {
-            const auto localPath = currentFile.parent_path() / includeName;
-            searchedPaths.push_back(localPath);
-            if (std::filesystem::is_regular_file(localPath))
-                return std::filesystem::weakly_canonical(localPath);
-        }
+            searchedPaths.push_back(currentFile.parent_path() / includeName);
 
         for (const auto& includeDir : includeDirectories)
+            searchedPaths.push_back(includeDir / includeName);
+
+        IncludePathCache::Key key = localInclude ? currentFile.parent_path().native() : IncludePathCache::Key();
+        key += '\0';
+        key += directoryListKey;
+        key += includeName.native();
+
+        auto& cache = IncludePathCache::Shared();
+        auto resolution = cache.Find(key, stamps);
+        if (!resolution.has_value())
         {
-            const auto candidate = includeDir / includeName;
-            searchedPaths.push_back(candidate);
-            if (std::filesystem::is_regular_file(candidate))
-                return std::filesystem::weakly_canonical(candidate);
+            resolution.emplace();
+            for (const auto& candidate : searchedPaths)
+            {
+                auto directory = candidate.parent_path();
+                const auto stamp = stamps.Get(directory);
+                resolution->probedDirectories.emplace_back(std::move(directory), stamp);
+                if (std::filesystem::is_regular_file(candidate))
+                {
+                    resolution->path = std::filesystem::weakly_canonical(candidate);
+                    break;
+                }
+            }
+
+            cache.Store(std::move(key), *resolution);
         }
 
+        if (resolution->path.has_value())
+            return *resolution->path;
+
         std::string message = "Could not resolve include " + includeName.string() + " from " + currentFile.string();
         if (!searchedPaths.empty())
         {
@@ -247,78 +241,203 @@ namespace
 
 namespace AutoItPreprocessor::Compiler
 {
+    struct IncludeResolver::IncludeNode
+    {
+        struct Target
+        {
+            std::filesystem::path path;
+            std::exception_ptr error;
+        };
+
+        std::shared_ptr<const CachedSource> source;
+        std::string_view text;
+        const SourceOutline* outline = nullptr;
+        std::exception_ptr loadError;
+        std::vector<Target> targets;
+    };
+
+    // Include graph discovered up front on the shared pool. Failures are recorded on the node or directive that
+    // produced them and rethrown while stitching, so errors surface in the same order as a serial walk.
+    struct IncludeResolver::IncludeGraph
+    {
+        std::mutex mutex;
+        std::unordered_map<std::filesystem::path, std::unique_ptr<IncludeNode>> nodes;
+        IncludePathCache::Key directoryListKey;
+        DirectoryStamps directoryStamps;
+        Common::TaskGroup tasks{Common::ThreadPool::Shared()};
+    };
+
+    // Stitching records views into the loaded sources in output order; the merged text is materialized once at
+    // the end, so nested includes are never copied into their parents.
+    struct IncludeResolver::StitchState
+    {
+        std::unordered_set<std::filesystem::path> seenFiles;
+        std::vector<std::filesystem::path> includedFiles;
+        std::vector<std::string_view> pieces;
+        std::vector<IncludeExpansion> includeExpansions;
+        LineOriginTable lineOrigins;
+        std::size_t byteCount = 0;
+    };
+
+    IncludeSearchPath IncludeResolver::PrepareSearchPath(const std::vector<std::filesystem::path>& includeDirectories)
+    {
+        IncludeSearchPath searchPath;
+        searchPath.directories = MergeIncludeDirectories(includeDirectories);
+        searchPath.key = MakeDirectoryListKey(searchPath.directories);
+        return searchPath;
+    }
+
     IncludeResolveResult IncludeResolver::Resolve(const std::filesystem::path& rootPath, const std::vector<std::filesystem::path>& includeDirectories) const
     {
-        return Resolve(Common::SourceDocument{
-            .path = rootPath,
-            .text = ReadFile(rootPath)
-        }, includeDirectories);
+        return Resolve(rootPath, PrepareSearchPath(includeDirectories));
     }
 
     IncludeResolveResult IncludeResolver::Resolve(const Common::SourceDocument& rootDocument, const std::vector<std::filesystem::path>& includeDirectories) const
     {
-        const auto mergedIncludeDirectories = MergeIncludeDirectories(includeDirectories);
-        std::unordered_set<std::filesystem::path> seenFiles;
-        std::vector<std::filesystem::path> includedFiles;
+        return Resolve(rootDocument, PrepareSearchPath(includeDirectories));
+    }
 
-        const auto canonicalRoot = std::filesystem::weakly_canonical(rootDocument.path);
-        const auto parsed = ResolveDocumentText(canonicalRoot, rootDocument.text, mergedIncludeDirectories, seenFiles, includedFiles);
+    IncludeResolveResult IncludeResolver::Resolve(const std::filesystem::path& rootPath, const IncludeSearchPath& searchPath) const
+    {
+        const auto canonicalRoot = std::filesystem::weakly_canonical(rootPath);
+        const auto rootSource = IncludeCache::Shared().Load(canonicalRoot);
+        return ResolveRoot(canonicalRoot, rootSource->text, &rootSource->outline, searchPath);
+    }
+
+    IncludeResolveResult IncludeResolver::Resolve(const Common::SourceDocument& rootDocument, const IncludeSearchPath& searchPath) const
+    {
+        return ResolveRoot(rootDocument.path, rootDocument.text, nullptr, searchPath);
+    }
+
+    IncludeResolveResult IncludeResolver::ResolveRoot(
+        const std::filesystem::path& rootPath,
+        std::string_view text,
+        const SourceOutline* cachedOutline,
+        const IncludeSearchPath& searchPath) const
+    {
+        const auto canonicalRoot = std::filesystem::weakly_canonical(rootPath);
+        std::optional<SourceOutline> parsedOutline;
+        if (cachedOutline == nullptr)
+            parsedOutline.emplace(SourceOutline::Parse(text));
+
+        IncludeGraph graph;
+        graph.directoryListKey = searchPath.key;
+        auto& rootNode = *graph.nodes.emplace(canonicalRoot, std::make_unique<IncludeNode>()).first->second;
+        rootNode.text = text;
+        rootNode.outline = cachedOutline != nullptr ? cachedOutline : &*parsedOutline;
+        DiscoverIncludes(graph, rootNode, canonicalRoot, searchPath.directories);
+        graph.tasks.Wait();
+
+        StitchState state;
+        ResolveDocumentText(canonicalRoot, rootNode, graph, state);
+
+        std::string mergedCode;
+        mergedCode.reserve(state.byteCount);
+        for (const auto piece : state.pieces)
+        {
+            mergedCode += piece;
+            if (!piece.ends_with('\n'))
+                mergedCode += '\n';
+        }
 
         return {
-            .mergedDocument = Common::SourceDocument{canonicalRoot, parsed.mergedCode},
-            .includedFiles = std::move(includedFiles),
-            .lineOrigins = std::move(parsed.lineOrigins),
-            .includeExpansions = std::move(parsed.includeExpansions)
+            .mergedDocument = Common::SourceDocument{canonicalRoot, std::move(mergedCode)},
+            .includedFiles = std::move(state.includedFiles),
+            .lineOrigins = std::move(state.lineOrigins),
+            .includeExpansions = std::move(state.includeExpansions)
         };
     }
 
-    IncludeResolver::ParseResult IncludeResolver::ResolveDocumentText(
+    void IncludeResolver::DiscoverIncludes(
+        IncludeGraph& graph,
+        IncludeNode& node,
         const std::filesystem::path& filePath,
-        const std::string& text,
-        const std::vector<std::filesystem::path>& includeDirectories,
-        std::unordered_set<std::filesystem::path>& seenFiles,
-        std::vector<std::filesystem::path>& includedFiles) const
+        const std::vector<std::filesystem::path>& includeDirectories) const
     {
-        if (seenFiles.contains(filePath))
-            return {};
-
-        seenFiles.insert(filePath);
-        includedFiles.push_back(filePath);
+        for (const auto& segment : node.outline->segments)
+        {
+            if (segment.kind != SourceSegmentKind::Include)
+                continue;
 
-        std::stringstream stream(text);
-        std::string mergedCode;
-        std::string line;
-        std::vector<ResolvedLineOrigin> lineOrigins;
-        std::vector<IncludeExpansion> includeExpansions;
-        bool includeOnce = false;
-        std::size_t fileLine = 0;
+            try
+            {
+                node.targets.push_back({ResolveIncludePath(
+                    node.text.substr(segment.offset, segment.length),
+                    filePath,
+                    includeDirectories,
+                    graph.directoryListKey,
+                    graph.directoryStamps), nullptr});
+            }
+            catch (...)
+            {
+                node.targets.push_back({{}, std::current_exception()});
+            }
+        }
 
-        while (std::getline(stream, line))
+        for (const auto& target : node.targets)
         {
-            ++fileLine;
-            const auto trimmed = Trim(line);
+            if (target.error)
+                continue;
 
-            if (trimmed == "#include-once")
+            IncludeNode* includedNode = nullptr;
             {
-                includeOnce = true;
-                continue;
+                const std::lock_guard lock(graph.mutex);
+                auto [entry, inserted] = graph.nodes.try_emplace(target.path);
+                if (!inserted)
+                    continue;
+
+                entry->second = std::make_unique<IncludeNode>();
+                includedNode = entry->second.get();
             }
 
-            if (StartsWithInclude(trimmed))
+            graph.tasks.Run([this, &graph, includedNode, &includedPath = target.path, &includeDirectories]
             {
-                const auto includePath = ResolveIncludePath(trimmed, filePath, includeDirectories);
-                const std::size_t mergedLineStart = lineOrigins.size() + 1U;
-                const auto nested = ResolveFile(includePath, includeDirectories, seenFiles, includedFiles);
-                mergedCode += nested.mergedCode;
-                lineOrigins.insert(lineOrigins.end(), nested.lineOrigins.begin(), nested.lineOrigins.end());
-                includeExpansions.insert(includeExpansions.end(), nested.includeExpansions.begin(), nested.includeExpansions.end());
-                if (!mergedCode.empty() && !mergedCode.ends_with('\n'))
-                    mergedCode += '\n';
-
-                const std::size_t mergedLineEnd = lineOrigins.size();
-                includeExpansions.push_back(IncludeExpansion{
+                try
+                {
+                    includedNode->source = IncludeCache::Shared().Load(includedPath);
+                }
+                catch (...)
+                {
+                    includedNode->loadError = std::current_exception();
+                    return;
+                }
+
+                includedNode->text = includedNode->source->text;
+                includedNode->outline = &includedNode->source->outline;
+                DiscoverIncludes(graph, *includedNode, includedPath, includeDirectories);
+            });
+        }
+    }
+
+    void IncludeResolver::ResolveDocumentText(
+        const std::filesystem::path& filePath,
+        const IncludeNode& node,
+        const IncludeGraph& graph,
+        StitchState& state) const
+    {
+        if (state.seenFiles.contains(filePath))
+            return;
+
+        state.seenFiles.insert(filePath);
+        state.includedFiles.push_back(filePath);
+        const auto fileId = state.lineOrigins.AddFile(filePath);
+
+        auto target = node.targets.begin();
+        for (const auto& segment : node.outline->segments)
+        {
+            if (segment.kind == SourceSegmentKind::Include)
+            {
+                const auto& [includePath, error] = *target++;
+                if (error)
+                    std::rethrow_exception(error);
+
+                const std::size_t mergedLineStart = state.lineOrigins.GetLineCount() + 1U;
+                ResolveFile(includePath, graph, state);
+
+                const std::size_t mergedLineEnd = state.lineOrigins.GetLineCount();
+                state.includeExpansions.push_back(IncludeExpansion{
                     .sourcePath = filePath,
-                    .sourceLine = fileLine,
+                    .sourceLine = segment.firstLine,
                     .includedPath = includePath,
                     .mergedLineStart = mergedLineStart,
                     .mergedLineEnd = mergedLineEnd,
@@ -328,28 +447,24 @@ namespace AutoItPreprocessor::Compiler
                 continue;
             }
 
-            mergedCode += line;
-            mergedCode += '\n';
-            lineOrigins.push_back(ResolvedLineOrigin{
-                .path = filePath,
-                .line = fileLine
-            });
+            state.pieces.push_back(node.text.substr(segment.offset, segment.length));
+            state.lineOrigins.AppendLines(fileId, segment.firstLine, segment.lineCount);
+            state.byteCount += segment.length + 1U;
         }
-
-        return {
-            .mergedCode = std::move(mergedCode),
-            .lineOrigins = std::move(lineOrigins),
-            .includeExpansions = std::move(includeExpansions),
-            .includeOnce = includeOnce
-        };
     }
 
-    IncludeResolver::ParseResult IncludeResolver::ResolveFile(
+    void IncludeResolver::ResolveFile(
         const std::filesystem::path& filePath,
-        const std::vector<std::filesystem::path>& includeDirectories,
-        std::unordered_set<std::filesystem::path>& seenFiles,
-        std::vector<std::filesystem::path>& includedFiles) const
+        const IncludeGraph& graph,
+        StitchState& state) const
     {
-        return ResolveDocumentText(filePath, ReadFile(filePath), includeDirectories, seenFiles, includedFiles);
+        if (state.seenFiles.contains(filePath))
+            return;
+
+        const auto& node = *graph.nodes.at(filePath);
+        if (node.loadError)
+            std::rethrow_exception(node.loadError);
+
+        ResolveDocumentText(filePath, node, graph, state);
     }
 }
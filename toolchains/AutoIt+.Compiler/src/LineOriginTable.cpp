@@ -0,0 +1,89 @@
+#include "AutoItPreprocessor/Compiler/LineOriginTable.h"
+
+#include <algorithm>
+
+namespace AutoItPreprocessor::Compiler
+{
+    FileId LineOriginTable::AddFile(const std::filesystem::path& path)
+    {
+        m_Files.push_back(path);
+        return static_cast<FileId>(m_Files.size() - 1U);
+    }
+
+    void LineOriginTable::AppendLines(FileId file, std::size_t sourceLineStart, std::size_t lineCount)
+    {
+        if (lineCount == 0)
+            return;
+
+        if (!m_Ranges.empty())
+        {
+            auto& last = m_Ranges.back();
+            if (last.file == file && last.sourceLineStart + last.lineCount == sourceLineStart)
+            {
+                last.lineCount += lineCount;
+                m_LineCount += lineCount;
+                return;
+            }
+        }
+
+        m_Ranges.push_back(LineOriginRange{
+            .file = file,
+            .mergedLineStart = m_LineCount + 1U,
+            .sourceLineStart = sourceLineStart,
+            .lineCount = lineCount
+        });
+        m_LineCount += lineCount;
+    }
+
+    void LineOriginTable::SpliceLines(std::size_t mergedLine, std::ptrdiff_t lineDelta) noexcept
+    {
+        if (lineDelta == 0 || mergedLine == 0 || mergedLine > m_LineCount)
+            return;
+
+        const auto shift = [lineDelta](std::size_t value)
+        {
+            return static_cast<std::size_t>(static_cast<std::ptrdiff_t>(value) + lineDelta);
+        };
+
+        auto range = std::prev(std::upper_bound(
+            m_Ranges.begin(),
+            m_Ranges.end(),
+            mergedLine,
+            [](std::size_t line, const LineOriginRange& candidate)
+            {
+                return line < candidate.mergedLineStart;
+            }));
+
+        const auto file = range->file;
+        range->lineCount = shift(range->lineCount);
+        for (++range; range != m_Ranges.end(); ++range)
+        {
+            range->mergedLineStart = shift(range->mergedLineStart);
+            if (range->file == file)
+                range->sourceLineStart = shift(range->sourceLineStart);
+        }
+
+        m_LineCount = shift(m_LineCount);
+    }
+
+    std::optional<LineOrigin> LineOriginTable::Find(std::size_t mergedLine) const noexcept
+    {
+        if (mergedLine == 0 || mergedLine > m_LineCount)
+            return std::nullopt;
+
+        const auto next = std::upper_bound(
+            m_Ranges.begin(),
+            m_Ranges.end(),
+            mergedLine,
+            [](std::size_t line, const LineOriginRange& range)
+            {
+                return line < range.mergedLineStart;
+            });
+
+        const auto& range = *std::prev(next);
+        return LineOrigin{
+            .file = range.file,
+            .line = range.sourceLineStart + (mergedLine - range.mergedLineStart)
+        };
+    }
+}
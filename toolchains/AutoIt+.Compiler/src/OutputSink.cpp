@@ -0,0 +1,67 @@
+#include "AutoItPreprocessor/Compiler/OutputSink.h"
+
+#include <stdexcept>
+
+namespace AutoItPreprocessor::Compiler
+{
+    FileSink::FileSink(const std::filesystem::path& path)
+        : m_File(path)
+        , m_Stream(&m_File)
+        , m_Description(path.string())
+    {
+        if (!m_File.is_open())
+            throw std::runtime_error("Could not write output file: " + m_Description);
+
+        m_Buffer.reserve(kChunkSize);
+    }
+
+    FileSink::FileSink(std::ostream& stream)
+        : m_Stream(&stream)
+        , m_Description("standard output")
+    {
+        m_Buffer.reserve(kChunkSize);
+    }
+
+    FileSink::~FileSink()
+    {
+        try
+        {
+            Flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    void FileSink::Write(std::string_view text)
+    {
+        m_BytesWritten += text.size();
+        if (m_Buffer.size() + text.size() <= kChunkSize)
+        {
+            m_Buffer += text;
+            return;
+        }
+
+        // Pieces that would not fit go out behind whatever is buffered; large ones skip the copy entirely.
+        WriteChunk(m_Buffer);
+        m_Buffer.clear();
+        if (text.size() >= kChunkSize)
+            WriteChunk(text);
+        else
+            m_Buffer += text;
+    }
+
+    void FileSink::Flush()
+    {
+        WriteChunk(m_Buffer);
+        m_Buffer.clear();
+        if (!m_Stream->flush())
+            throw std::runtime_error("Could not write output file: " + m_Description);
+    }
+
+    void FileSink::WriteChunk(std::string_view chunk)
+    {
+        if (!chunk.empty() && !m_Stream->write(chunk.data(), static_cast<std::streamsize>(chunk.size())))
+            throw std::runtime_error("Could not write output file: " + m_Description);
+    }
+}
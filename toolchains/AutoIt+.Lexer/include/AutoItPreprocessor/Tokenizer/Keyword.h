@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace AutoItPreprocessor::Tokenizer
+{
+    enum class Keyword : std::uint8_t
+    {
+        None,
+        False,
+        True,
+        ContinueCase,
+        ContinueLoop,
+        Default,
+        Dim,
+        ReDim,
+        Global,
+        Local,
+        Const,
+        ByRef,
+        Do,
+        Until,
+        Enum,
+        Exit,
+        ExitLoop,
+        For,
+        To,
+        In,
+        Step,
+        Next,
+        Func,
+        Return,
+        EndFunc,
+        If,
+        Then,
+        ElseIf,
+        Else,
+        EndIf,
+        Null,
+        Select,
+        Case,
+        EndSelect,
+        Static,
+        Switch,
+        EndSwitch,
+        While,
+        WEnd,
+        With,
+        EndWith,
+        Not,
+        And,
+        Or,
+    };
+
+    [[nodiscard]] Keyword ClassifyKeyword(std::string_view value) noexcept;
+}
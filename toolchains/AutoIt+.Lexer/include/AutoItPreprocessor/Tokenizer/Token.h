@@ -1,11 +1,15 @@
 #pragma once
 
+#include "AutoItPreprocessor/Tokenizer/Keyword.h"
+
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace AutoItPreprocessor::Tokenizer
 {
-    enum class TokenKind
+    enum class TokenKind : std::uint8_t
     {
         Start,
         End,
@@ -44,34 +48,44 @@ namespace AutoItPreprocessor::Tokenizer
         Error,
     };
 
+    struct CustomBinding
+    {
+        std::string name;
+        std::string replacement;
+    };
+
+    // Tokens do not own their text: the content views into the buffer handed to the Tokenizer and a custom
+    // binding points at storage owned by the rule set, so both must outlive the token.
     class Token
     {
     public:
         Token() = default;
-        Token(TokenKind kind, std::size_t line, std::size_t start, std::size_t end, std::string content);
+        Token(TokenKind kind, std::size_t line, std::size_t start, std::string_view content, Keyword keyword = Keyword::None) noexcept;
 
         [[nodiscard]] TokenKind GetKind() const noexcept { return m_Kind; }
+        [[nodiscard]] Keyword GetKeyword() const noexcept { return m_Keyword; }
         [[nodiscard]] std::size_t GetLine() const noexcept { return m_Line; }
         [[nodiscard]] std::size_t GetStart() const noexcept { return m_Start; }
-        [[nodiscard]] std::size_t GetEnd() const noexcept { return m_End; }
-        [[nodiscard]] const std::string& GetContent() const noexcept { return m_Content; }
-        [[nodiscard]] const std::string& GetCustomName() const noexcept { return m_CustomName; }
-        [[nodiscard]] const std::string& GetReplacement() const noexcept { return m_Replacement; }
+        [[nodiscard]] std::size_t GetEnd() const noexcept { return m_Start + m_Content.size(); }
+        [[nodiscard]] std::string_view GetContent() const noexcept { return m_Content; }
+        [[nodiscard]] std::string_view GetCustomName() const noexcept { return m_Binding != nullptr ? std::string_view(m_Binding->name) : std::string_view(); }
+        [[nodiscard]] std::string_view GetReplacement() const noexcept { return m_Binding != nullptr ? std::string_view(m_Binding->replacement) : std::string_view(); }
         [[nodiscard]] bool Is(TokenKind kind) const noexcept { return m_Kind == kind; }
 
-        void RebindAsCustom(std::string customName, std::string replacement);
+        void RebindAsCustom(const CustomBinding& binding) noexcept;
+        // Points the token at an equal span in another buffer, keeping its kind, keyword and binding.
+        void Relocate(std::string_view content, std::size_t line, std::size_t start) noexcept;
 
     private:
-        TokenKind m_Kind = TokenKind::Start;
+        std::string_view m_Content;
+        const CustomBinding* m_Binding = nullptr;
         std::size_t m_Line = 1;
         std::size_t m_Start = 0;
-        std::size_t m_End = 0;
-        std::string m_Content;
-        std::string m_CustomName;
-        std::string m_Replacement;
+        TokenKind m_Kind = TokenKind::Start;
+        Keyword m_Keyword = Keyword::None;
     };
 
-    [[nodiscard]] std::string ToLowerCopy(std::string value);
-    [[nodiscard]] std::string ToUpperCopy(std::string value);
+    [[nodiscard]] std::string ToLowerCopy(std::string_view value);
+    [[nodiscard]] std::string ToUpperCopy(std::string_view value);
     [[nodiscard]] const char* ToString(TokenKind kind) noexcept;
 }
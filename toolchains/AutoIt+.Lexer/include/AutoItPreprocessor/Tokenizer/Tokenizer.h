@@ -3,24 +3,50 @@
 #include "AutoItPreprocessor/Tokenizer/Token.h"
 
 #include <cstddef>
-#include <string>
+#include <string_view>
 #include <vector>
 
 namespace AutoItPreprocessor::Tokenizer
 {
+    // The tokenizer scans the caller's buffer in place; it must stay alive for as long as any produced token is used.
     class Tokenizer
     {
     public:
-        explicit Tokenizer(std::string sourceText);
+        explicit Tokenizer(std::string_view sourceText) noexcept;
 
-        [[nodiscard]] Token Peek();
+        // Returns the token `offset` positions ahead of the cursor without consuming it; Peek(0) is what Next() returns.
+        [[nodiscard]] Token Peek(std::size_t offset = 0);
         [[nodiscard]] Token Next();
         [[nodiscard]] Token Current() const noexcept { return m_Current; }
-        [[nodiscard]] std::size_t GetLine() const noexcept { return m_Line; }
+        [[nodiscard]] std::size_t GetLine() const noexcept { return m_LookaheadCount > 0 ? m_Lookahead[m_LookaheadHead].lineBefore : m_Line; }
         [[nodiscard]] std::vector<Token> TokenizeAll();
         void Reset() noexcept;
+        // Resumes scanning at a byte offset that starts a token; `line` is the number reported for that position.
+        void Seek(std::size_t offset, std::size_t line) noexcept;
+
+        // Hands each token to the visitor as soon as it is scanned, ending with the End or Error token.
+        // The visitor may rebind the token in place; nothing is retained between calls.
+        template <typename Visitor>
+        void ForEachToken(Visitor&& visitor)
+        {
+            while (true)
+            {
+                auto token = Next();
+                visitor(token);
+                if (token.Is(TokenKind::End) || token.Is(TokenKind::Error))
+                    break;
+            }
+        }
 
     private:
+        struct Lookahead
+        {
+            Token token;
+            std::size_t lineBefore = 1;
+        };
+
+        Token Scan();
+        void GrowLookahead();
         Token MakeSpace();
         Token MakeTab();
         Token MakeIdentifier();
@@ -36,18 +62,21 @@ namespace AutoItPreprocessor::Tokenizer
         Token MakeMacro();
         Token MakeSingle(TokenKind kind);
         Token MakeError();
-        std::string PeekLine() const;
-        std::string NextLine();
+        Token MakeToken(TokenKind kind, std::size_t line, const char* start) const noexcept;
+        bool LookingAt(std::string_view text) const noexcept;
+        std::string_view NextLine() noexcept;
 
         char GetCurrent() const noexcept;
         char GetNext() noexcept;
         char PeekNextChar() const noexcept;
 
-        std::string m_SourceText;
         const char* m_Begin = nullptr;
         const char* m_Cursor = nullptr;
         const char* m_End = nullptr;
         std::size_t m_Line = 1;
         Token m_Current = {};
+        std::vector<Lookahead> m_Lookahead;
+        std::size_t m_LookaheadHead = 0;
+        std::size_t m_LookaheadCount = 0;
     };
 }
@@ -0,0 +1,112 @@
+#include "AutoItPreprocessor/Tokenizer/Keyword.h"
+
+#include <array>
+#include <cstddef>
+
+namespace
+{
+    using AutoItPreprocessor::Tokenizer::Keyword;
+
+    struct KeywordEntry
+    {
+        std::string_view text;
+        Keyword keyword;
+    };
+
+    constexpr KeywordEntry kKeywords[] = {
+        {"false", Keyword::False}, {"true", Keyword::True}, {"continuecase", Keyword::ContinueCase},
+        {"continueloop", Keyword::ContinueLoop}, {"default", Keyword::Default}, {"dim", Keyword::Dim},
+        {"redim", Keyword::ReDim}, {"global", Keyword::Global}, {"local", Keyword::Local},
+        {"const", Keyword::Const}, {"byref", Keyword::ByRef}, {"do", Keyword::Do}, {"until", Keyword::Until},
+        {"enum", Keyword::Enum}, {"exit", Keyword::Exit}, {"exitloop", Keyword::ExitLoop}, {"for", Keyword::For},
+        {"to", Keyword::To}, {"in", Keyword::In}, {"step", Keyword::Step}, {"next", Keyword::Next},
+        {"func", Keyword::Func}, {"return", Keyword::Return}, {"endfunc", Keyword::EndFunc}, {"if", Keyword::If},
+        {"then", Keyword::Then}, {"elseif", Keyword::ElseIf}, {"else", Keyword::Else}, {"endif", Keyword::EndIf},
+        {"null", Keyword::Null}, {"select", Keyword::Select}, {"case", Keyword::Case},
+        {"endselect", Keyword::EndSelect}, {"static", Keyword::Static}, {"switch", Keyword::Switch},
+        {"endswitch", Keyword::EndSwitch}, {"while", Keyword::While}, {"wend", Keyword::WEnd},
+        {"with", Keyword::With}, {"endwith", Keyword::EndWith}, {"not", Keyword::Not}, {"and", Keyword::And},
+        {"or", Keyword::Or}
+    };
+
+    constexpr std::size_t kTableSize = 128;
+
+    // Setting the 0x20 bit lower-cases ASCII letters and never turns a non-letter into one, so comparing
+    // folded input against the lower-case table is an exact case-insensitive match.
+    constexpr unsigned char FoldCase(char c) noexcept
+    {
+        return static_cast<unsigned char>(c | 0x20);
+    }
+
+    // Length, first, second and last character are enough to place every keyword in its own slot.
+    constexpr std::size_t HashKeyword(std::string_view value) noexcept
+    {
+        return (value.size() + FoldCase(value.front()) * 11U + FoldCase(value[1]) + FoldCase(value.back()) * 16U) % kTableSize;
+    }
+
+    constexpr std::size_t kMinKeywordLength = []
+    {
+        std::size_t length = kKeywords[0].text.size();
+        for (const auto& entry : kKeywords)
+            length = entry.text.size() < length ? entry.text.size() : length;
+        return length;
+    }();
+
+    constexpr std::size_t kMaxKeywordLength = []
+    {
+        std::size_t length = 0;
+        for (const auto& entry : kKeywords)
+            length = entry.text.size() > length ? entry.text.size() : length;
+        return length;
+    }();
+
+    static_assert(kMinKeywordLength >= 2U, "HashKeyword reads the second character");
+
+    // Slots hold an index into kKeywords plus one; zero marks an empty slot.
+    constexpr auto kKeywordTable = []
+    {
+        std::array<std::uint8_t, kTableSize> table{};
+        for (std::size_t index = 0; index < std::size(kKeywords); ++index)
+            table[HashKeyword(kKeywords[index].text)] = static_cast<std::uint8_t>(index + 1U);
+        return table;
+    }();
+
+    constexpr bool IsCollisionFree()
+    {
+        std::size_t occupied = 0;
+        for (const auto slot : kKeywordTable)
+        {
+            if (slot != 0)
+                ++occupied;
+        }
+
+        return occupied == std::size(kKeywords);
+    }
+
+    static_assert(IsCollisionFree(), "Keyword hash has collisions; adjust HashKeyword");
+}
+
+namespace AutoItPreprocessor::Tokenizer
+{
+    Keyword ClassifyKeyword(std::string_view value) noexcept
+    {
+        if (value.size() < kMinKeywordLength || value.size() > kMaxKeywordLength)
+            return Keyword::None;
+
+        const auto slot = kKeywordTable[HashKeyword(value)];
+        if (slot == 0)
+            return Keyword::None;
+
+        const auto& entry = kKeywords[slot - 1U];
+        if (entry.text.size() != value.size())
+            return Keyword::None;
+
+        for (std::size_t index = 0; index < value.size(); ++index)
+        {
+            if (FoldCase(value[index]) != static_cast<unsigned char>(entry.text[index]))
+                return Keyword::None;
+        }
+
+        return entry.keyword;
+    }
+}
@@ -0,0 +1,232 @@
+#include "ScanKernels.h"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AUTOIT_SCAN_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AUTOIT_TARGET_AVX2
+#else
+#define AUTOIT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    bool IsLineEnd(char c) noexcept
+    {
+        return c == '\n' || c == '\0';
+    }
+
+    bool IsSpace(char c) noexcept
+    {
+        return c == ' ' || c == '\r';
+    }
+
+    const char* ScalarFindLineEnd(const char* cursor, const char* end) noexcept
+    {
+        while (cursor < end && !IsLineEnd(*cursor))
+            ++cursor;
+        return cursor;
+    }
+
+    const char* ScalarFindLineEndOr(const char* cursor, const char* end, char symbol) noexcept
+    {
+        while (cursor < end && !IsLineEnd(*cursor) && *cursor != symbol)
+            ++cursor;
+        return cursor;
+    }
+
+    const char* ScalarSkipSpaces(const char* cursor, const char* end) noexcept
+    {
+        while (cursor < end && IsSpace(*cursor))
+            ++cursor;
+        return cursor;
+    }
+
+#if defined(AUTOIT_SCAN_X64)
+    // SSE2 is part of the x86-64 baseline, so these need no runtime check.
+
+    __m128i LoadSse2(const char* cursor) noexcept
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+    }
+
+    const char* Sse2FindLineEnd(const char* cursor, const char* end) noexcept
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i zero = _mm_setzero_si128();
+        for (; end - cursor >= 16; cursor += 16)
+        {
+            const __m128i chunk = LoadSse2(cursor);
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, zero))));
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return ScalarFindLineEnd(cursor, end);
+    }
+
+    const char* Sse2FindLineEndOr(const char* cursor, const char* end, char symbol) noexcept
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wanted = _mm_set1_epi8(symbol);
+        for (; end - cursor >= 16; cursor += 16)
+        {
+            const __m128i chunk = LoadSse2(cursor);
+            const __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, zero)), _mm_cmpeq_epi8(chunk, wanted));
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return ScalarFindLineEndOr(cursor, end, symbol);
+    }
+
+    const char* Sse2SkipSpaces(const char* cursor, const char* end) noexcept
+    {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i carriageReturn = _mm_set1_epi8('\r');
+        for (; end - cursor >= 16; cursor += 16)
+        {
+            const __m128i chunk = LoadSse2(cursor);
+            const auto spaces = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, carriageReturn))));
+            const auto mask = ~spaces & 0xFFFFU;
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return ScalarSkipSpaces(cursor, end);
+    }
+
+    AUTOIT_TARGET_AVX2 __m256i LoadAvx2(const char* cursor) noexcept
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+    }
+
+    AUTOIT_TARGET_AVX2 const char* Avx2FindLineEnd(const char* cursor, const char* end) noexcept
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i zero = _mm256_setzero_si256();
+        for (; end - cursor >= 32; cursor += 32)
+        {
+            const __m256i chunk = LoadAvx2(cursor);
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, zero))));
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return Sse2FindLineEnd(cursor, end);
+    }
+
+    AUTOIT_TARGET_AVX2 const char* Avx2FindLineEndOr(const char* cursor, const char* end, char symbol) noexcept
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i wanted = _mm256_set1_epi8(symbol);
+        for (; end - cursor >= 32; cursor += 32)
+        {
+            const __m256i chunk = LoadAvx2(cursor);
+            const __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, zero)), _mm256_cmpeq_epi8(chunk, wanted));
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return Sse2FindLineEndOr(cursor, end, symbol);
+    }
+
+    AUTOIT_TARGET_AVX2 const char* Avx2SkipSpaces(const char* cursor, const char* end) noexcept
+    {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i carriageReturn = _mm256_set1_epi8('\r');
+        for (; end - cursor >= 32; cursor += 32)
+        {
+            const __m256i chunk = LoadAvx2(cursor);
+            const auto spaces = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, carriageReturn))));
+            const auto mask = ~spaces;
+            if (mask != 0)
+                return cursor + std::countr_zero(mask);
+        }
+
+        return Sse2SkipSpaces(cursor, end);
+    }
+
+    bool CpuSupportsAvx2() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4] = {};
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        __cpuid(info, 1);
+        constexpr int kOsxsaveBit = 1 << 27;
+        constexpr int kAvxBit = 1 << 28;
+        if ((info[2] & kOsxsaveBit) == 0 || (info[2] & kAvxBit) == 0)
+            return false;
+
+        constexpr unsigned long long kYmmStateMask = 0x6;
+        if ((_xgetbv(0) & kYmmStateMask) != kYmmStateMask)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        constexpr int kAvx2Bit = 1 << 5;
+        return (info[1] & kAvx2Bit) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct KernelTable
+    {
+        const char* (*findLineEnd)(const char*, const char*) noexcept;
+        const char* (*findLineEndOr)(const char*, const char*, char) noexcept;
+        const char* (*skipSpaces)(const char*, const char*) noexcept;
+    };
+
+    KernelTable SelectKernels() noexcept
+    {
+#if defined(AUTOIT_SCAN_X64)
+        if (CpuSupportsAvx2())
+            return {Avx2FindLineEnd, Avx2FindLineEndOr, Avx2SkipSpaces};
+
+        return {Sse2FindLineEnd, Sse2FindLineEndOr, Sse2SkipSpaces};
+#else
+        return {ScalarFindLineEnd, ScalarFindLineEndOr, ScalarSkipSpaces};
+#endif
+    }
+
+    const KernelTable& GetKernels() noexcept
+    {
+        static const KernelTable kernels = SelectKernels();
+        return kernels;
+    }
+}
+
+namespace AutoItPreprocessor::Tokenizer::ScanKernels
+{
+    const char* FindLineEnd(const char* cursor, const char* end) noexcept
+    {
+        return GetKernels().findLineEnd(cursor, end);
+    }
+
+    const char* FindLineEndOr(const char* cursor, const char* end, char symbol) noexcept
+    {
+        return GetKernels().findLineEndOr(cursor, end, symbol);
+    }
+
+    const char* SkipSpaces(const char* cursor, const char* end) noexcept
+    {
+        // Most whitespace runs are a single separator, so avoid the vector setup for those.
+        if (cursor < end && !IsSpace(*cursor))
+            return cursor;
+
+        return GetKernels().skipSpaces(cursor, end);
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace AutoItPreprocessor::Tokenizer::ScanKernels
+{
+    // Each kernel returns the first matching byte in [cursor, end), or end when there is none.
+    // A NUL byte always stops a scan because the tokenizer treats it as end of input.
+
+    [[nodiscard]] const char* FindLineEnd(const char* cursor, const char* end) noexcept;
+    [[nodiscard]] const char* FindLineEndOr(const char* cursor, const char* end, char symbol) noexcept;
+    [[nodiscard]] const char* SkipSpaces(const char* cursor, const char* end) noexcept;
+}
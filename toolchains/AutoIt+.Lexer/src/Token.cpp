@@ -2,32 +2,39 @@
 
 #include <algorithm>
 #include <cctype>
-#include <utility>
 
 namespace AutoItPreprocessor::Tokenizer
 {
-    Token::Token(TokenKind kind, std::size_t line, std::size_t start, std::size_t end, std::string content)
-        : m_Kind(kind), m_Line(line), m_Start(start), m_End(end), m_Content(std::move(content))
+    Token::Token(TokenKind kind, std::size_t line, std::size_t start, std::string_view content, Keyword keyword) noexcept
+        : m_Content(content), m_Line(line), m_Start(start), m_Kind(kind), m_Keyword(keyword)
     {
     }
 
-    void Token::RebindAsCustom(std::string customName, std::string replacement)
+    void Token::RebindAsCustom(const CustomBinding& binding) noexcept
     {
         m_Kind = TokenKind::Custom;
-        m_CustomName = std::move(customName);
-        m_Replacement = std::move(replacement);
+        m_Binding = &binding;
     }
 
-    std::string ToLowerCopy(std::string value)
+    void Token::Relocate(std::string_view content, std::size_t line, std::size_t start) noexcept
     {
-        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-        return value;
+        m_Content = content;
+        m_Line = line;
+        m_Start = start;
     }
 
-    std::string ToUpperCopy(std::string value)
+    std::string ToLowerCopy(std::string_view value)
     {
-        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
-        return value;
+        std::string result(value);
+        std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return result;
+    }
+
+    std::string ToUpperCopy(std::string_view value)
+    {
+        std::string result(value);
+        std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        return result;
     }
 
     const char* ToString(TokenKind kind) noexcept
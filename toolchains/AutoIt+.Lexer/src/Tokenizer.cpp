@@ -1,218 +1,256 @@
 #include "AutoItPreprocessor/Tokenizer/Tokenizer.h"
 
+#include "ScanKernels.h"
+
 #include <algorithm>
-#include <iterator>
-#include <string>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
 
 namespace
 {
-    bool IsSpace(char c) noexcept
+    using AutoItPreprocessor::Tokenizer::TokenKind;
+
+    enum class CharAction : std::uint8_t
     {
-        return c == ' ' || c == '\r';
-    }
+        Error,
+        End,
+        Space,
+        Tab,
+        LineFeed,
+        Digit,
+        Underscore,
+        Identifier,
+        SingleQuote,
+        DoubleQuote,
+        Macro,
+        Comment,
+        Directive,
+        Variable,
+        Object,
+        Single,
+    };
+
+    enum CharTrait : std::uint8_t
+    {
+        kTraitSpace = 1U << 0,
+        kTraitDigit = 1U << 1,
+        kTraitHexDigit = 1U << 2,
+        kTraitIdentifier = 1U << 3,
+    };
 
-    bool IsDigit(char c) noexcept
+    struct CharClass
+    {
+        CharAction action = CharAction::Error;
+        TokenKind singleKind = TokenKind::Error;
+        std::uint8_t traits = 0;
+    };
+
+    constexpr auto kCharClasses = []
+    {
+        std::array<CharClass, 256> table{};
+
+        const auto setAction = [&table](char c, CharAction action, TokenKind singleKind = TokenKind::Error)
+        {
+            auto& entry = table[static_cast<unsigned char>(c)];
+            entry.action = action;
+            entry.singleKind = singleKind;
+        };
+
+        const auto addTrait = [&table](char c, std::uint8_t trait)
+        {
+            table[static_cast<unsigned char>(c)].traits |= trait;
+        };
+
+        for (char c = 'a'; c <= 'z'; ++c)
+        {
+            setAction(c, CharAction::Identifier);
+            addTrait(c, kTraitIdentifier);
+        }
+
+        for (char c = 'A'; c <= 'Z'; ++c)
+        {
+            setAction(c, CharAction::Identifier);
+            addTrait(c, kTraitIdentifier);
+        }
+
+        for (char c = '0'; c <= '9'; ++c)
+        {
+            setAction(c, CharAction::Digit);
+            addTrait(c, kTraitDigit | kTraitHexDigit | kTraitIdentifier);
+        }
+
+        for (char c = 'a'; c <= 'f'; ++c)
+            addTrait(c, kTraitHexDigit);
+
+        for (char c = 'A'; c <= 'F'; ++c)
+            addTrait(c, kTraitHexDigit);
+
+        setAction('_', CharAction::Underscore);
+        addTrait('_', kTraitIdentifier);
+
+        setAction(' ', CharAction::Space);
+        addTrait(' ', kTraitSpace);
+        setAction('\r', CharAction::Space);
+        addTrait('\r', kTraitSpace);
+
+        setAction('\0', CharAction::End);
+        setAction('\t', CharAction::Tab);
+        setAction('\n', CharAction::LineFeed, TokenKind::LineFeed);
+        setAction('\'', CharAction::SingleQuote);
+        setAction('"', CharAction::DoubleQuote);
+        setAction('@', CharAction::Macro);
+        setAction(';', CharAction::Comment);
+        setAction('#', CharAction::Directive);
+        setAction('$', CharAction::Variable);
+        setAction('.', CharAction::Object);
+
+        setAction('(', CharAction::Single, TokenKind::OpenedParen);
+        setAction(')', CharAction::Single, TokenKind::ClosedParen);
+        setAction('[', CharAction::Single, TokenKind::OpenedSquare);
+        setAction(']', CharAction::Single, TokenKind::ClosedSquare);
+        setAction('<', CharAction::Single, TokenKind::LessThan);
+        setAction('>', CharAction::Single, TokenKind::GreaterThan);
+        setAction('=', CharAction::Single, TokenKind::Equal);
+        setAction('+', CharAction::Single, TokenKind::Plus);
+        setAction('-', CharAction::Single, TokenKind::Minus);
+        setAction('*', CharAction::Single, TokenKind::Asterisk);
+        setAction('/', CharAction::Single, TokenKind::Slash);
+        setAction('^', CharAction::Single, TokenKind::Power);
+        setAction(',', CharAction::Single, TokenKind::Comma);
+        setAction(':', CharAction::Single, TokenKind::Colon);
+        setAction('&', CharAction::Single, TokenKind::Concatenate);
+        setAction('?', CharAction::Single, TokenKind::Questionmark);
+
+        return table;
+    }();
+
+    const CharClass& ClassOf(char c) noexcept
     {
-        return c >= '0' && c <= '9';
+        return kCharClasses[static_cast<unsigned char>(c)];
     }
 
-    bool IsHexDigit(char c) noexcept
+    bool HasTrait(char c, std::uint8_t trait) noexcept
     {
-        return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        return (ClassOf(c).traits & trait) != 0;
     }
 
-    bool IsIdentifierChar(char c) noexcept
+    bool IsSpace(char c) noexcept
     {
-        return (c >= 'a' && c <= 'z')
-            || (c >= 'A' && c <= 'Z')
-            || (c >= '0' && c <= '9')
-            || c == '_';
+        return HasTrait(c, kTraitSpace);
     }
 
-    bool IsKeyword(const std::string& value)
+    bool IsDigit(char c) noexcept
     {
-        using AutoItPreprocessor::Tokenizer::ToLowerCopy;
-        const auto lowered = ToLowerCopy(value);
+        return HasTrait(c, kTraitDigit);
+    }
 
-        static const char* keywords[] = {
-            "false", "true", "continuecase", "continueloop", "default", "dim", "redim", "global",
-            "local", "const", "byref", "do", "until", "enum", "exit", "exitloop", "for", "to", "in",
-            "step", "next", "func", "return", "endfunc", "if", "then", "elseif", "else", "endif",
-            "null", "select", "case", "endselect", "static", "switch", "endswitch", "while", "wend",
-            "with", "endwith", "not", "and", "or"
-        };
+    bool IsHexDigit(char c) noexcept
+    {
+        return HasTrait(c, kTraitHexDigit);
+    }
 
-        return std::find(std::begin(keywords), std::end(keywords), lowered) != std::end(keywords);
+    bool IsIdentifierChar(char c) noexcept
+    {
+        return HasTrait(c, kTraitIdentifier);
     }
 }
 
 namespace AutoItPreprocessor::Tokenizer
 {
-    Tokenizer::Tokenizer(std::string sourceText)
-        : m_SourceText(std::move(sourceText))
+    Tokenizer::Tokenizer(std::string_view sourceText) noexcept
+        : m_Begin(sourceText.data()), m_Cursor(sourceText.data()), m_End(sourceText.data() + sourceText.size())
     {
-        m_Begin = m_SourceText.c_str();
-        m_Cursor = m_Begin;
-        m_End = m_Begin + m_SourceText.size();
     }
 
-    Token Tokenizer::Peek()
+    Token Tokenizer::Peek(std::size_t offset)
     {
-        const auto current = m_Current;
-        const auto cursor = m_Cursor;
-        const auto line = m_Line;
-
-        const auto peeked = Next();
+        while (m_LookaheadCount <= offset)
+        {
+            if (m_LookaheadCount == m_Lookahead.size())
+                GrowLookahead();
 
-        m_Current = current;
-        m_Cursor = cursor;
-        m_Line = line;
+            const auto line = m_Line;
+            auto token = Scan();
+            m_Lookahead[(m_LookaheadHead + m_LookaheadCount) & (m_Lookahead.size() - 1U)] = Lookahead{token, line};
+            ++m_LookaheadCount;
+        }
 
-        return peeked;
+        return m_Lookahead[(m_LookaheadHead + offset) & (m_Lookahead.size() - 1U)].token;
     }
 
     Token Tokenizer::Next()
     {
-        const char curr = GetCurrent();
-        if (curr == '\0')
-        {
-            const auto offset = static_cast<std::size_t>(m_Cursor - m_Begin);
-            m_Current = Token(TokenKind::End, m_Line, offset, offset, "");
-            return m_Current;
-        }
-
-        if (IsSpace(curr))
+        if (m_LookaheadCount > 0)
         {
-            m_Current = MakeSpace();
+            m_Current = m_Lookahead[m_LookaheadHead].token;
+            m_LookaheadHead = (m_LookaheadHead + 1U) & (m_Lookahead.size() - 1U);
+            --m_LookaheadCount;
             return m_Current;
         }
 
-        if (curr == '\t')
-        {
-            m_Current = MakeTab();
-            return m_Current;
-        }
-
-        const auto next = PeekNextChar();
-        if (curr == '0' && (next == 'x' || next == 'X'))
-        {
-            m_Current = MakeHex();
-            return m_Current;
-        }
-
-        if (IsDigit(curr))
-        {
-            m_Current = MakeDecimals();
-            return m_Current;
-        }
-
-        if (curr == '_' && (IsSpace(next) || next == '\n'))
-        {
-            m_Current = MakeMultiline();
-            return m_Current;
-        }
+        m_Current = Scan();
+        return m_Current;
+    }
 
-        if (IsIdentifierChar(curr))
-        {
-            m_Current = MakeIdentifier();
-            return m_Current;
-        }
+    Token Tokenizer::Scan()
+    {
+        const char curr = GetCurrent();
+        const auto& charClass = ClassOf(curr);
 
-        switch (curr)
+        switch (charClass.action)
         {
-            case '\'':
-                m_Current = MakeString('\'');
-                break;
-            case '"':
-                m_Current = MakeString('"');
-                break;
-            case '@':
-                m_Current = MakeMacro();
-                break;
-            case ';':
-                m_Current = MakeComment();
-                break;
-            case '#':
-                m_Current = PeekLine().starts_with("#cs") || PeekLine().starts_with("#comment-start") ? MakeMultiComment() : MakeCommand();
-                break;
-            case '$':
-                m_Current = MakeVariable();
-                break;
-            case '.':
-                m_Current = MakeObject();
-                break;
-            case '(':
-                m_Current = MakeSingle(TokenKind::OpenedParen);
-                break;
-            case ')':
-                m_Current = MakeSingle(TokenKind::ClosedParen);
-                break;
-            case '[':
-                m_Current = MakeSingle(TokenKind::OpenedSquare);
-                break;
-            case ']':
-                m_Current = MakeSingle(TokenKind::ClosedSquare);
-                break;
-            case '<':
-                m_Current = MakeSingle(TokenKind::LessThan);
-                break;
-            case '>':
-                m_Current = MakeSingle(TokenKind::GreaterThan);
-                break;
-            case '=':
-                m_Current = MakeSingle(TokenKind::Equal);
-                break;
-            case '+':
-                m_Current = MakeSingle(TokenKind::Plus);
-                break;
-            case '-':
-                m_Current = MakeSingle(TokenKind::Minus);
-                break;
-            case '*':
-                m_Current = MakeSingle(TokenKind::Asterisk);
-                break;
-            case '/':
-                m_Current = MakeSingle(TokenKind::Slash);
-                break;
-            case '^':
-                m_Current = MakeSingle(TokenKind::Power);
-                break;
-            case ',':
-                m_Current = MakeSingle(TokenKind::Comma);
-                break;
-            case ':':
-                m_Current = MakeSingle(TokenKind::Colon);
-                break;
-            case '&':
-                m_Current = MakeSingle(TokenKind::Concatenate);
-                break;
-            case '?':
-                m_Current = MakeSingle(TokenKind::Questionmark);
-                break;
-            case '\n':
-                m_Current = MakeSingle(TokenKind::LineFeed);
+            case CharAction::End:
+                return MakeToken(TokenKind::End, m_Line, m_Cursor);
+            case CharAction::Space:
+                return MakeSpace();
+            case CharAction::Tab:
+                return MakeTab();
+            case CharAction::LineFeed:
+            {
+                auto token = MakeSingle(TokenKind::LineFeed);
                 m_Line++;
-                break;
+                return token;
+            }
+            case CharAction::Digit:
+            {
+                const auto next = PeekNextChar();
+                return curr == '0' && (next == 'x' || next == 'X') ? MakeHex() : MakeDecimals();
+            }
+            case CharAction::Underscore:
+            {
+                const auto next = PeekNextChar();
+                return IsSpace(next) || next == '\n' ? MakeMultiline() : MakeIdentifier();
+            }
+            case CharAction::Identifier:
+                return MakeIdentifier();
+            case CharAction::SingleQuote:
+                return MakeString('\'');
+            case CharAction::DoubleQuote:
+                return MakeString('"');
+            case CharAction::Macro:
+                return MakeMacro();
+            case CharAction::Comment:
+                return MakeComment();
+            case CharAction::Directive:
+                return LookingAt("#cs") || LookingAt("#comment-start") ? MakeMultiComment() : MakeCommand();
+            case CharAction::Variable:
+                return MakeVariable();
+            case CharAction::Object:
+                return MakeObject();
+            case CharAction::Single:
+                return MakeSingle(charClass.singleKind);
+            case CharAction::Error:
             default:
-                m_Current = MakeError();
-                break;
+                return MakeError();
         }
-
-        return m_Current;
     }
 
     std::vector<Token> Tokenizer::TokenizeAll()
     {
         std::vector<Token> tokens;
-
-        while (true)
-        {
-            auto token = Next();
-            tokens.push_back(token);
-            if (token.Is(TokenKind::End) || token.Is(TokenKind::Error))
-                break;
-        }
-
+        ForEachToken([&tokens](const Token& token) { tokens.push_back(token); });
         return tokens;
     }
 
@@ -221,26 +259,42 @@ namespace AutoItPreprocessor::Tokenizer
         m_Cursor = m_Begin;
         m_Line = 1;
         m_Current = {};
+        m_LookaheadHead = 0;
+        m_LookaheadCount = 0;
+    }
+
+    void Tokenizer::Seek(std::size_t offset, std::size_t line) noexcept
+    {
+        m_Cursor = m_Begin + std::min(offset, static_cast<std::size_t>(m_End - m_Begin));
+        m_Line = line;
+        m_Current = {};
+        m_LookaheadHead = 0;
+        m_LookaheadCount = 0;
+    }
+
+    void Tokenizer::GrowLookahead()
+    {
+        // The capacity stays a power of two so ring positions can be masked instead of divided.
+        std::vector<Lookahead> grown(m_Lookahead.empty() ? 8U : m_Lookahead.size() * 2U);
+        for (std::size_t index = 0; index < m_LookaheadCount; ++index)
+            grown[index] = m_Lookahead[(m_LookaheadHead + index) & (m_Lookahead.size() - 1U)];
+
+        m_Lookahead = std::move(grown);
+        m_LookaheadHead = 0;
     }
 
     Token Tokenizer::MakeSpace()
     {
         const char* start = m_Cursor;
         GetNext();
+        m_Cursor = ScanKernels::SkipSpaces(m_Cursor, m_End);
 
-        while (IsSpace(GetCurrent()))
-            GetNext();
-
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Space, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Space, m_Line, start);
     }
 
     Token Tokenizer::MakeTab()
     {
-        const auto startOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        const char content = GetNext();
-        return Token(TokenKind::Tab, m_Line, startOffset, startOffset + 1U, std::string(1, content));
+        return MakeSingle(TokenKind::Tab);
     }
 
     Token Tokenizer::MakeIdentifier()
@@ -250,20 +304,15 @@ namespace AutoItPreprocessor::Tokenizer
         while (IsIdentifierChar(GetCurrent()))
             GetNext();
 
+        const std::string_view content(start, static_cast<std::size_t>(m_Cursor - start));
+        const auto keyword = ClassifyKeyword(content);
         const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        std::string content(start, m_Cursor);
-        const auto kind = IsKeyword(content) ? TokenKind::Keyword : TokenKind::Word;
-        return Token(kind, m_Line, startOffset, endOffset, std::move(content));
+        return Token(keyword != Keyword::None ? TokenKind::Keyword : TokenKind::Word, m_Line, startOffset, content, keyword);
     }
 
     Token Tokenizer::MakeMultiline()
     {
-        const auto startOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        const char* start = m_Cursor;
-        GetNext();
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Multiline, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeSingle(TokenKind::Multiline);
     }
 
     Token Tokenizer::MakeDecimals()
@@ -273,9 +322,7 @@ namespace AutoItPreprocessor::Tokenizer
         while (IsDigit(GetCurrent()))
             GetNext();
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Decimals, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Decimals, m_Line, start);
     }
 
     Token Tokenizer::MakeHex()
@@ -289,21 +336,16 @@ namespace AutoItPreprocessor::Tokenizer
                 GetNext();
         }
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Hex, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Hex, m_Line, start);
     }
 
     Token Tokenizer::MakeCommand()
     {
         const char* start = m_Cursor;
         GetNext();
-        while (GetCurrent() != '\0' && GetCurrent() != '\n')
-            GetNext();
+        m_Cursor = ScanKernels::FindLineEnd(m_Cursor, m_End);
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::AutoItCommand, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::AutoItCommand, m_Line, start);
     }
 
     Token Tokenizer::MakeVariable()
@@ -313,9 +355,7 @@ namespace AutoItPreprocessor::Tokenizer
         while (IsIdentifierChar(GetCurrent()))
             GetNext();
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Variable, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Variable, m_Line, start);
     }
 
     Token Tokenizer::MakeObject()
@@ -325,21 +365,16 @@ namespace AutoItPreprocessor::Tokenizer
         while (IsIdentifierChar(GetCurrent()))
             GetNext();
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Object, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Object, m_Line, start);
     }
 
     Token Tokenizer::MakeComment()
     {
         const char* start = m_Cursor;
         GetNext();
-        while (GetCurrent() != '\0' && GetCurrent() != '\n')
-            GetNext();
+        m_Cursor = ScanKernels::FindLineEnd(m_Cursor, m_End);
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Comment, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Comment, m_Line, start);
     }
 
     Token Tokenizer::MakeMultiComment()
@@ -347,30 +382,27 @@ namespace AutoItPreprocessor::Tokenizer
         const auto startLine = m_Line;
         const char* start = m_Cursor;
 
-        while (GetCurrent() != '\0')
+        while (true)
         {
-            if (GetCurrent() == '\n')
+            m_Cursor = ScanKernels::FindLineEndOr(m_Cursor, m_End, '#');
+            const char current = GetCurrent();
+            if (current == '\0')
+                break;
+
+            if (current == '\n')
             {
                 m_Line++;
             }
-            else if (GetCurrent() == '#')
+            else if (LookingAt("#ce") || LookingAt("#comment-end"))
             {
-                const auto line = PeekLine();
-                if (line.starts_with("#ce") || line.starts_with("#comment-end"))
-                {
-                    NextLine();
-                    break;
-                }
+                NextLine();
+                break;
             }
 
             GetNext();
         }
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return GetCurrent() == '\0'
-            ? Token(TokenKind::Error, startLine, startOffset, endOffset, std::string(start, m_Cursor))
-            : Token(TokenKind::MultiComment, startLine, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(GetCurrent() == '\0' ? TokenKind::Error : TokenKind::MultiComment, startLine, start);
     }
 
     Token Tokenizer::MakeString(char endSymbol)
@@ -378,23 +410,21 @@ namespace AutoItPreprocessor::Tokenizer
         const char* start = m_Cursor;
         GetNext();
 
-        while (GetCurrent() != '\0')
+        while (true)
         {
-            const char current = GetNext();
+            m_Cursor = ScanKernels::FindLineEndOr(m_Cursor, m_End, endSymbol);
+            const char current = GetCurrent();
+            if (current == '\0')
+                break;
+
+            GetNext();
             if (current == '\n')
                 m_Line++;
-
-            if (current == endSymbol)
-            {
-                const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-                const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-                return Token(TokenKind::String, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
-            }
+            else
+                return MakeToken(TokenKind::String, m_Line, start);
         }
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Error, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Error, m_Line, start);
     }
 
     Token Tokenizer::MakeMacro()
@@ -404,16 +434,14 @@ namespace AutoItPreprocessor::Tokenizer
         while (IsIdentifierChar(GetCurrent()))
             GetNext();
 
-        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
-        const auto endOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        return Token(TokenKind::Macro, m_Line, startOffset, endOffset, std::string(start, m_Cursor));
+        return MakeToken(TokenKind::Macro, m_Line, start);
     }
 
     Token Tokenizer::MakeSingle(TokenKind kind)
     {
-        const auto startOffset = static_cast<std::size_t>(m_Cursor - m_Begin);
-        const char current = GetNext();
-        return Token(kind, m_Line, startOffset, startOffset + 1U, std::string(1, current));
+        const char* start = m_Cursor;
+        GetNext();
+        return MakeToken(kind, m_Line, start);
     }
 
     Token Tokenizer::MakeError()
@@ -421,22 +449,23 @@ namespace AutoItPreprocessor::Tokenizer
         return MakeSingle(TokenKind::Error);
     }
 
-    std::string Tokenizer::PeekLine() const
+    Token Tokenizer::MakeToken(TokenKind kind, std::size_t line, const char* start) const noexcept
     {
-        const char* end = m_Cursor;
-        while (*end != '\0' && *end != '\n')
-            end++;
+        const auto startOffset = static_cast<std::size_t>(start - m_Begin);
+        return Token(kind, line, startOffset, std::string_view(start, static_cast<std::size_t>(m_Cursor - start)));
+    }
 
-        return std::string(m_Cursor, end);
+    bool Tokenizer::LookingAt(std::string_view text) const noexcept
+    {
+        return std::string_view(m_Cursor, static_cast<std::size_t>(m_End - m_Cursor)).starts_with(text);
     }
 
-    std::string Tokenizer::NextLine()
+    std::string_view Tokenizer::NextLine() noexcept
     {
         const char* start = m_Cursor;
-        while (GetCurrent() != '\0' && GetCurrent() != '\n')
-            GetNext();
+        m_Cursor = ScanKernels::FindLineEnd(m_Cursor, m_End);
 
-        return std::string(start, m_Cursor);
+        return std::string_view(start, static_cast<std::size_t>(m_Cursor - start));
     }
 
     char Tokenizer::GetCurrent() const noexcept
@@ -0,0 +1,337 @@
+#include "AutoItPreprocessor/Common/SourceDocument.h"
+#include "AutoItPreprocessor/Compiler/CompilationSession.h"
+#include "AutoItPreprocessor/Compiler/Compiler.h"
+#include "AutoItPreprocessor/Tokenizer/Token.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    using namespace AutoItPreprocessor;
+
+    constexpr unsigned kSeeds = 40;
+    constexpr std::size_t kEditsPerSeed = 150;
+    constexpr std::size_t kSnippetsPerDocument = 12;
+
+    constexpr std::string_view kRules =
+        "token Config\n"
+        "pattern=__APP_CFG_*__\n"
+        "emit=Cfg(\"\\1\")\n"
+        "kinds=Word\n"
+        "end\n"
+        "\n"
+        "sequence MsgBoxToConsole\n"
+        "match=Word:MsgBox OpenedParen * Comma * ClosedParen\n"
+        "emit=ConsoleWrite(\\5 & @CRLF)\n"
+        "case=insensitive\n"
+        "end\n";
+
+    constexpr std::string_view kLibrary =
+        "Func Lib()\n"
+        "\tMsgBox(1, \"lib\", 2)\n"
+        "EndFunc\n";
+
+    // Each snippet exercises something the session has to re-lex across lines.
+    constexpr std::array<std::string_view, 11> kSnippets = {
+        "#include \"lib.au3\"\n",
+        "Local $a = 1\n",
+        "MsgBox(0, \"t\", $a)\n",
+        "MsgBox(0, _\n    \"two\" & (1 + 2))\n",
+        "$b = \"multi\nline\" & $a\n",
+        "#cs\nblock \"text\n#ce\n",
+        "; comment\n",
+        "If $a Then _ ; note\n    $a += 1\n",
+        "__APP_CFG_Name__ = 2\n",
+        "Func f()\n\tReturn Nested(Call((1), [2]))\nEndFunc\n",
+        "\n"
+    };
+
+    constexpr std::array<std::string_view, 16> kInsertions = {
+        "", "a", " ", "\n", "\"", "_", "(", ")", ",", "MsgBox", "#cs\n", "#ce\n", "; ", " _\n", "$x", "__APP_CFG_Q__"
+    };
+
+    struct Scenario
+    {
+        std::string_view name;
+        std::string_view before;
+        std::string_view after;
+    };
+
+    // Hand-picked edits around constructs that span lines, next to the randomized ones.
+    constexpr std::array<Scenario, 10> kScenarios = {{
+        {"multi-line string before the window", "a = 1\n\"x\ny\" & b\nc = 2\n", "a = 1\n\"x\ny\" & bQ\nc = 2\n"},
+        {"document starting with a multi-line string", "\"\n\"", "\"\n \""},
+        {"edit inside a #cs block", "x = 1\n#cs\nfoo\n#ce\ny = 2\n", "x = 1\n#cs\nfoo bar\n#ce\ny = 2\n"},
+        {"remove the end of a #cs block", "x = 1\n#cs\nfoo\n#ce\ny = 2\nz = 3\n", "x = 1\n#cs\nfoo\n#c\ny = 2\nz = 3\n"},
+        {"edit on a continued line", "x = 1 + _\n  2\ny = 3\n", "x = 1 + _\n  42\ny = 3\n"},
+        {"add a continuation", "x = 1 +\n  2\ny = 3\n", "x = 1 + _\n  2\ny = 3\n"},
+        {"sequence across a continuation", "MsgBox(0, _\n \"hi\")\nz = 1\n", "MsgBox(0, _\n \"hello\")\nz = 1\n"},
+        {"sequence broken by an edit", "MsgBox(0, \"a\", 1)\nz = 1\n", "MsgBox(0 \"a\", 1)\nz = 1\n"},
+        {"edit below an include", "#include \"lib.au3\"\nx = 1\ny = 2\n", "#include \"lib.au3\"\nx = 1\n\ny = 2\n"},
+        {"edit above an include", "x = 1\n#include \"lib.au3\"\ny = 2\n", "x = 1\nw = 0\n#include \"lib.au3\"\ny = 2\n"}
+    }};
+
+    void PrintUsage()
+    {
+        std::cerr
+            << "Usage:\n"
+            << "  AutoItPreprocessor.SessionTests [--work-dir <dir>]\n"
+            << "      Applies scripted and random edits through CompilationSession::Update and compares every result\n"
+            << "      with a fresh Compiler::Compile of the same text.\n";
+    }
+
+    std::filesystem::path ParseArguments(int argc, char** argv)
+    {
+        auto workDir = std::filesystem::temp_directory_path() / "AutoItPreprocessor.SessionTests";
+        for (int index = 1; index < argc; ++index)
+        {
+            const std::string arg = argv[index];
+            if (arg != "--work-dir")
+                throw std::runtime_error("Unknown argument: " + arg);
+            if (++index >= argc)
+                throw std::runtime_error("Missing path after --work-dir");
+            workDir = argv[index];
+        }
+
+        return workDir;
+    }
+
+    void WriteFile(const std::filesystem::path& path, std::string_view text)
+    {
+        std::ofstream output(path, std::ios::binary);
+        if (!output.is_open() || !output.write(text.data(), static_cast<std::streamsize>(text.size())))
+            throw std::runtime_error("Could not write " + path.string());
+    }
+
+    std::string Describe(const Tokenizer::Token& token)
+    {
+        std::ostringstream description;
+        description
+            << Tokenizer::ToString(token.GetKind()) << " line " << token.GetLine() << " start " << token.GetStart()
+            << " '" << token.GetContent() << "' -> '" << token.GetReplacement() << "'";
+        return description.str();
+    }
+
+    std::string Describe(const Compiler::LineMapping& mapping)
+    {
+        std::ostringstream description;
+        description
+            << "file " << mapping.sourceFile << " line " << mapping.sourceLine << " merged " << mapping.mergedSourceLine
+            << " generated " << mapping.generatedLineStart << '-' << mapping.generatedLineEnd;
+        return description.str();
+    }
+
+    std::string Describe(const Compiler::GeneratedIncludeExpansion& expansion)
+    {
+        std::ostringstream description;
+        description
+            << expansion.sourcePath.string() << ':' << expansion.sourceLine << " -> " << expansion.includedPath.string()
+            << " generated " << expansion.generatedLineStart << '-' << expansion.generatedLineEnd
+            << (expansion.skipped ? " skipped" : "");
+        return description.str();
+    }
+
+    template <typename T>
+    void CompareLists(std::string_view what, const std::vector<T>& actual, const std::vector<T>& expected)
+    {
+        for (std::size_t index = 0; index < std::max(actual.size(), expected.size()); ++index)
+        {
+            const auto actualText = index < actual.size() ? Describe(actual[index]) : std::string("<none>");
+            const auto expectedText = index < expected.size() ? Describe(expected[index]) : std::string("<none>");
+            if (actualText != expectedText)
+            {
+                throw std::runtime_error(
+                    std::string(what) + " " + std::to_string(index) + " is " + actualText + ", expected " + expectedText);
+            }
+        }
+    }
+
+    // Everything a caller of the session can observe has to match a compile from scratch.
+    void CompareUnits(const Compiler::CompilationUnit& actual, const Compiler::CompilationUnit& expected)
+    {
+        CompareLists("token", actual.tokens, expected.tokens);
+        if (actual.strippedCode != expected.strippedCode)
+            throw std::runtime_error("strippedCode differs:\n" + actual.strippedCode + "\nexpected:\n" + expected.strippedCode);
+        if (actual.generatedCode != expected.generatedCode)
+            throw std::runtime_error("generatedCode differs:\n" + actual.generatedCode + "\nexpected:\n" + expected.generatedCode);
+        CompareLists("line mapping", actual.lineMappings, expected.lineMappings);
+        CompareLists("include expansion", actual.includeExpansions, expected.includeExpansions);
+    }
+
+    class SessionChecker
+    {
+    public:
+        SessionChecker(std::filesystem::path rootPath, Compiler::CompilerOptions options)
+            : m_RootPath(std::move(rootPath)),
+              m_Options(std::move(options)),
+              m_Session(m_Options)
+        {
+        }
+
+        void Start(const std::string& text)
+        {
+            Check(text, [&] { m_Session.Compile(Common::SourceDocument{m_RootPath, text}); });
+        }
+
+        void Update(const std::string& text)
+        {
+            Check(text, [&] { m_Session.Update(Common::SourceDocument{m_RootPath, text}); });
+        }
+
+    private:
+        // An edit may break an #include line; the session then has to fail with the same error as a fresh compile.
+        template <typename Step>
+        void Check(const std::string& text, Step&& step)
+        {
+            std::string actualError;
+            try
+            {
+                step();
+            }
+            catch (const std::exception& exception)
+            {
+                actualError = exception.what();
+            }
+
+            std::string expectedError;
+            Compiler::CompilationUnit expected;
+            try
+            {
+                expected = m_Compiler.Compile(Common::SourceDocument{m_RootPath, text}, m_Options);
+            }
+            catch (const std::exception& exception)
+            {
+                expectedError = exception.what();
+            }
+
+            try
+            {
+                if (actualError != expectedError)
+                    throw std::runtime_error("error is '" + actualError + "', expected '" + expectedError + "'");
+                if (expectedError.empty())
+                    CompareUnits(m_Session.GetUnit(), expected);
+            }
+            catch (const std::runtime_error& error)
+            {
+                throw std::runtime_error(std::string(error.what()) + "\ndocument:\n" + text);
+            }
+        }
+
+        std::filesystem::path m_RootPath;
+        Compiler::CompilerOptions m_Options;
+        Compiler::Compiler m_Compiler;
+        Compiler::CompilationSession m_Session;
+    };
+
+    std::string MakeDocument(std::mt19937& random)
+    {
+        std::uniform_int_distribution<std::size_t> pick(0, kSnippets.size() - 1U);
+        std::string text;
+        for (std::size_t index = 0; index < kSnippetsPerDocument; ++index)
+            text += kSnippets[pick(random)];
+
+        return text;
+    }
+
+    std::string MakeEdit(std::mt19937& random, const std::string& text)
+    {
+        std::uniform_int_distribution<std::size_t> offsetPick(0, text.size());
+        std::uniform_int_distribution<std::size_t> lengthPick(0, 4);
+        std::uniform_int_distribution<std::size_t> insertionPick(0, kInsertions.size() - 1U);
+
+        const auto offset = offsetPick(random);
+        const auto length = std::min(lengthPick(random), text.size() - offset);
+        auto edited = text;
+        edited.replace(offset, length, kInsertions[insertionPick(random)]);
+        return edited;
+    }
+
+    void RunScenarios(const std::filesystem::path& rootPath, const Compiler::CompilerOptions& options)
+    {
+        for (const auto& scenario : kScenarios)
+        {
+            try
+            {
+                SessionChecker checker(rootPath, options);
+                checker.Start(std::string(scenario.before));
+                checker.Update(std::string(scenario.after));
+                checker.Update(std::string(scenario.before));
+            }
+            catch (const std::runtime_error& error)
+            {
+                throw std::runtime_error("Scenario '" + std::string(scenario.name) + "' failed: " + error.what());
+            }
+        }
+    }
+
+    void RunRandomEdits(const std::filesystem::path& rootPath, const Compiler::CompilerOptions& options)
+    {
+        for (unsigned seed = 1; seed <= kSeeds; ++seed)
+        {
+            std::mt19937 random(seed);
+            try
+            {
+                SessionChecker checker(rootPath, options);
+                auto text = MakeDocument(random);
+                checker.Start(text);
+                for (std::size_t edit = 0; edit < kEditsPerSeed; ++edit)
+                {
+                    text = MakeEdit(random, text);
+                    checker.Update(text);
+                }
+            }
+            catch (const std::runtime_error& error)
+            {
+                throw std::runtime_error("Random edits with seed " + std::to_string(seed) + " failed: " + error.what());
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto workDir = ParseArguments(argc, argv);
+        std::filesystem::create_directories(workDir);
+
+        const auto rulesFile = workDir / "session.tokens";
+        WriteFile(rulesFile, kRules);
+        WriteFile(workDir / "lib.au3", kLibrary);
+
+        Compiler::CompilerOptions options;
+        options.customRuleFiles.push_back(rulesFile);
+
+        // The root document is never written; its path only anchors the relative include.
+        const auto rootPath = workDir / "root.au3";
+        RunScenarios(rootPath, options);
+        RunRandomEdits(rootPath, options);
+
+        std::filesystem::remove(rulesFile);
+        std::filesystem::remove(workDir / "lib.au3");
+        std::error_code ignored;
+        std::filesystem::remove(workDir, ignored);
+
+        std::cout << "Checked " << kScenarios.size() << " scenarios and " << kSeeds * kEditsPerSeed << " random edits\n";
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << '\n';
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+}